@@ -0,0 +1,48 @@
+#include "AsyncJobs.h"
+
+AsyncJobs::AsyncJobs(QObject *parent)
+    : QObject{parent} {
+    qRegisterMetaType<camcalib::CalibrationStage>();
+}
+
+AsyncJobs::~AsyncJobs() {
+    mGeneration.cancel();
+    std::unique_lock lock{mMutex};
+    mIdle.wait(lock, [this]{
+        return mRunning == 0;
+    });
+}
+
+void AsyncJobs::cancel() {
+    mGeneration.cancel();
+    if(mActive) {
+        mActive = false;
+        emit finished();
+    }
+}
+
+void AsyncJobs::beginJob() {
+    std::lock_guard lock{mMutex};
+    mRunning++;
+}
+
+void AsyncJobs::endJob() {
+    std::lock_guard lock{mMutex};
+    if(--mRunning == 0) {
+        mIdle.notify_all();
+    }
+}
+
+QString stageName(camcalib::CalibrationStage stage) {
+    switch(stage) {
+    case camcalib::CalibrationStage::Edges:
+        return QObject::tr("Поиск краев");
+    case camcalib::CalibrationStage::Components:
+        return QObject::tr("Разметка компонент");
+    case camcalib::CalibrationStage::Fit:
+        return QObject::tr("Оценка окружностей");
+    case camcalib::CalibrationStage::Solve:
+        return QObject::tr("Решение");
+    }
+    return {};
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include "Progress.h"
+#include <condition_variable>
+#include <mutex>
+
+Q_DECLARE_METATYPE(camcalib::CalibrationStage)
+
+// Задания владельца в общем пуле потоков. Новое задание отменяет предыдущее,
+// результат отмененного задания не доставляется.
+class AsyncJobs : public QObject {
+    Q_OBJECT
+public:
+    explicit AsyncJobs(QObject *parent = nullptr);
+    // Ожидает завершения запущенных заданий, результаты не доставляются
+    ~AsyncJobs();
+    // work(progress) выполняется в пуле потоков, done(result) - в потоке объекта.
+    // work должна захватывать данные по значению.
+    template<typename Work, typename Done>
+    void start(Work work, Done done);
+    void cancel();
+    bool isRunning() const {
+        return mActive;
+    }
+signals:
+    // Этап текущего задания
+    void stageChanged(camcalib::CalibrationStage stage);
+    void finished();
+private:
+    void beginJob();
+    void endJob();
+    camcalib::JobGeneration mGeneration;
+    // Задание, результат которого ожидается
+    bool mActive{false};
+    std::mutex mMutex;
+    std::condition_variable mIdle;
+    size_t mRunning{0};
+};
+
+QString stageName(camcalib::CalibrationStage stage);
+
+template<typename Work, typename Done>
+void AsyncJobs::start(Work work, Done done) {
+    auto token = mGeneration.next();
+    mActive = true;
+    beginJob();
+    QThreadPool::globalInstance()->start([this, token, work = std::move(work), done = std::move(done)]() mutable {
+        camcalib::ProgressCallback progress = [this, token](camcalib::CalibrationStage stage) {
+            if(token.isCancelled()) {
+                return false;
+            }
+            emit stageChanged(stage);
+            return true;
+        };
+        auto result = work(progress);
+        // Объект жив, пока задание не завершено (см. деструктор),
+        // события, не доставленные до удаления объекта, отбрасываются
+        QMetaObject::invokeMethod(this, [this, token, done = std::move(done), result = std::move(result)]() mutable {
+            if(token.isCancelled()) {
+                return;
+            }
+            mActive = false;
+            done(std::move(result));
+            emit finished();
+        }, Qt::QueuedConnection);
+        endJob();
+    });
+}
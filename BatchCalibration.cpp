@@ -0,0 +1,194 @@
+#include "BatchCalibration.h"
+#include "Calibration.h"
+#include "MappedImage.h"
+#include "MeasurementModel.h"
+#include "PixelSizeEstimator.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <execution>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace camcalib {
+
+static bool matchWildcard(const std::string& pattern, const std::string& text) {
+    // '*' - любая последовательность символов, '?' - один символ
+    size_t p = 0, t = 0, star = std::string::npos, mark = 0;
+    while(t < text.size()) {
+        if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            ++p;
+            ++t;
+        } else if(p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            mark = t;
+        } else if(star != std::string::npos) {
+            p = star + 1;
+            t = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while(p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+static bool isImageFile(const fs::path& path) {
+    static const auto extensions = std::vector<std::string>{
+        ".bmp", ".jpg", ".jpeg", ".png", ".tif", ".tiff", ".pgm", ".raw"
+    };
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){
+        return static_cast<char>(std::tolower(c));
+    });
+    return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+}
+
+std::vector<std::string> collectImageFiles(const std::string &pattern) {
+    std::vector<std::string> result;
+    std::error_code ec;
+    auto path = fs::path(pattern);
+    if(fs::is_directory(path, ec)) {
+        for(const auto& entry: fs::directory_iterator(path, ec)) {
+            if(entry.is_regular_file() && isImageFile(entry.path())) {
+                result.push_back(entry.path().string());
+            }
+        }
+    } else {
+        auto dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+        auto mask = path.filename().string();
+        for(const auto& entry: fs::directory_iterator(dir, ec)) {
+            if(entry.is_regular_file() && matchWildcard(mask, entry.path().filename().string())) {
+                result.push_back(entry.path().string());
+            }
+        }
+    }
+    if(ec) {
+        std::cerr << __FUNCTION__": " << ec.message() << std::endl;
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+template<typename Callable>
+static inline auto measure(double& elapsed, Callable callable) {
+    auto start = std::chrono::steady_clock::now();
+    auto result = callable();
+    elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static BatchImageResult calibrateImage(const std::string& filename,
+                                       const CalibrationParams& params) {
+    BatchImageResult result;
+    result.filename = filename;
+    auto frame = measure(result.loadTime, [&]{
+        // Кадр используется только для поиска меток, 16-битные PGM не копируются целиком
+        CAMCALIB_TRACE_SCOPE("mapGrayscaleImage");
+        return mapGrayscaleImage(filename);
+    });
+    if(frame.image.empty()) {
+        std::cerr << __FUNCTION__": can't read " << filename << std::endl;
+        return result;
+    }
+    auto grid = measure(result.detectionTime, [&]{
+        return detectGridCorrespondences(frame, params);
+    });
+    result.detectedPoints = grid.centersImage.size();
+    result.imageSize = frame.image.size();
+    if(grid.centersImage.empty()) {
+        return result;
+    }
+    result.cameraMatrix = measure(result.calibrationTime, [&]{
+        return calibrate(grid.centersImage, grid.centersWorld);
+    });
+    result.view = {std::move(grid.centersImage), std::move(grid.centersWorld)};
+    return result;
+}
+
+std::vector<BatchImageResult> calibrateImages(const std::vector<std::string> &files,
+                                              const CalibrationParams &params) {
+    std::vector<BatchImageResult> results(files.size());
+    // Кадры раздаются параллельному алгоритму стандартной библиотеки,
+    // балансировку нагрузки между потоками выполняет его планировщик
+    std::transform(std::execution::par,
+                   files.begin(),
+                   files.end(),
+                   results.begin(),
+                   [&](const std::string& filename) {
+                       return calibrateImage(filename, params);
+                   });
+    return results;
+}
+
+std::optional<cv::Size2d> averagePixelSize(const std::vector<BatchImageResult> &results) {
+    // Один проход по точкам всех кадров, кадры взвешены числом найденных меток
+    PixelSizeEstimator estimator;
+    for(const auto& result: results) {
+        if(result.cameraMatrix) {
+            estimator.addFrame(result.view.centersImage, result.view.centersWorld);
+        }
+    }
+    return estimator.pixelSize();
+}
+
+std::optional<DistortionCalibrationResult> calibrateDistortion(const std::vector<BatchImageResult> &results) {
+    std::vector<DistortionView> views;
+    cv::Size imageSize;
+    for(const auto& result: results) {
+        if(result.view.centersImage.empty()) {
+            continue;
+        }
+        if(imageSize.empty()) {
+            imageSize = result.imageSize;
+        }
+        if(result.imageSize == imageSize) {
+            views.push_back(result.view);
+        } else {
+            std::cerr << __FUNCTION__": image size differs, skipped " << result.filename << std::endl;
+        }
+    }
+    return calibrateDistortion(views, imageSize);
+}
+
+bool saveBatchReport(const std::string &filename,
+                     const std::string &magnificationName,
+                     const std::vector<BatchImageResult> &results,
+                     const std::optional<LensDistortion> &distortion) {
+    auto pixelSize = averagePixelSize(results);
+    cv::FileStorage storage(filename, cv::FileStorage::WRITE);
+    if(!storage.isOpened()) {
+        std::cerr << __FUNCTION__": can't open " << filename << std::endl;
+        return false;
+    }
+    // Модель камеры в формате CameraModel, отчет по снимкам - дополнительный узел
+    auto model = MeasurementModel{std::nullopt, distortion, {}};
+    if(pixelSize) {
+        model.magnifications.push_back({magnificationName, *pixelSize});
+    }
+    writeMeasurementModel(storage, model);
+    storage << "images" << "[";
+    for(const auto& result: results) {
+        storage << "{"
+                << "file" << result.filename
+                << "detected_points" << static_cast<int>(result.detectedPoints)
+                << "load_ms" << result.loadTime
+                << "detection_ms" << result.detectionTime
+                << "calibration_ms" << result.calibrationTime;
+        if(result.cameraMatrix) {
+            storage << "pixel_size" << cv::Size2d{1.0 / (*result.cameraMatrix)(0, 0),
+                                                  1.0 / (*result.cameraMatrix)(1, 1)};
+        }
+        storage << "}";
+    }
+    storage << "]";
+    storage.release();
+    return pixelSize.has_value();
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CalibrationParams.h"
+#include "DistortionCalibration.h"
+#include <opencv2/core.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace camcalib {
+
+struct BatchImageResult {
+    std::string filename;
+    std::optional<cv::Matx33f> cameraMatrix{};
+    size_t detectedPoints{};
+    cv::Size imageSize{};
+    // Соответствия для совместной оценки дисторсии
+    DistortionView view{};
+    // Время этапов, мс
+    double loadTime{};
+    double detectionTime{};
+    double calibrationTime{};
+};
+
+// pattern - каталог или маска файлов вида "dir/*.png"
+std::vector<std::string> collectImageFiles(const std::string& pattern);
+
+std::vector<BatchImageResult> calibrateImages(const std::vector<std::string>& files,
+                                              const CalibrationParams& params);
+
+// Совместная оценка по соответствиям всех откалиброванных кадров (PixelSizeEstimator)
+std::optional<cv::Size2d> averagePixelSize(const std::vector<BatchImageResult>& results);
+
+// Совместная оценка по всем кадрам размера первого успешного кадра
+std::optional<DistortionCalibrationResult> calibrateDistortion(const std::vector<BatchImageResult>& results);
+
+// Формат совместим с CameraModel::loadFromFile, результаты по кадрам пишутся в узел "images"
+bool saveBatchReport(const std::string& filename,
+                     const std::string& magnificationName,
+                     const std::vector<BatchImageResult>& results,
+                     const std::optional<LensDistortion>& distortion = std::nullopt);
+
+}
@@ -0,0 +1,619 @@
+#include "Calibration.h"
+#include "GridTracker.h"
+#include "MeasurementModel.h"
+#include "CircleFit.h"
+#include "DetectionCache.h"
+#include "OpticalCenter.h"
+#include "PixelSizeEstimator.h"
+#include "SyntheticTarget.h"
+#include "Undistortion.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+// Сравнение методов оценки окружностей на синтетическом изображении с известными центрами
+
+namespace {
+
+struct SyntheticGrid {
+    cv::Mat image;
+    std::vector<cv::Vec3f> circles;
+};
+
+SyntheticGrid renderGrid(const cv::Size& gridSize, double step, double radius, double blurSigma) {
+    auto params = camcalib::SyntheticTargetParams{};
+    params.gridSize = gridSize;
+    params.gridStep = step;
+    params.dotRadius = radius;
+    params.pixelSize = 1.0;
+    // Небольшой поворот, чтобы центры не совпадали с узлами пиксельной сетки
+    params.rotation = 0.002;
+    params.blurSigma = blurSigma;
+    auto target = camcalib::renderSyntheticTarget(params);
+    return {std::move(target.image), std::move(target.circlesImage)};
+}
+
+const char* methodName(camcalib::CircleFitMethod method) {
+    switch(method) {
+    case camcalib::CircleFitMethod::Ellipse:
+        return "ellipse";
+    case camcalib::CircleFitMethod::GradientWeighted:
+        return "gradient";
+    case camcalib::CircleFitMethod::Geometric:
+        return "geometric";
+    }
+    return "";
+}
+
+struct Statistics {
+    double millisecondsPerImage{};
+    double microsecondsPerDot{};
+    double rmsError{};
+    double repeatability{};
+    int failures{};
+};
+
+Statistics measure(const SyntheticGrid& grid, const camcalib::GridSearchParams& params,
+                   double noiseSigma, int trials) {
+    Statistics stats;
+    cv::RNG rng(12345);
+    auto dots = grid.circles.size();
+    std::vector<cv::Point2d> sum(dots), sum2(dots);
+    auto errorSum = 0.0;
+    auto measured = 0;
+    for(int trial = 0; trial < trials; trial++) {
+        cv::Mat noise(grid.image.size(), CV_16S);
+        rng.fill(noise, cv::RNG::NORMAL, 0.0, noiseSigma);
+        cv::Mat image;
+        cv::add(grid.image, noise, image, cv::noArray(), CV_8U);
+        auto start = std::chrono::steady_clock::now();
+        auto circles = camcalib::findCirclesGrid(image, params);
+        stats.millisecondsPerImage += std::chrono::duration<double, std::milli>(
+                                          std::chrono::steady_clock::now() - start).count();
+        if(circles.size() != dots) {
+            ++stats.failures;
+            continue;
+        }
+        for(size_t i = 0; i < dots; i++) {
+            auto pos = cv::Point2d(circles[i][0], circles[i][1]);
+            auto error = pos - cv::Point2d(grid.circles[i][0], grid.circles[i][1]);
+            errorSum += error.dot(error);
+            sum[i] += pos;
+            sum2[i] += cv::Point2d(pos.x * pos.x, pos.y * pos.y);
+        }
+        ++measured;
+    }
+    stats.millisecondsPerImage /= trials;
+    stats.microsecondsPerDot = 1000.0 * stats.millisecondsPerImage / dots;
+    if(measured > 0) {
+        stats.rmsError = std::sqrt(errorSum / (measured * dots));
+        auto variance = 0.0;
+        for(size_t i = 0; i < dots; i++) {
+            auto mean = sum[i] / measured;
+            variance += sum2[i].x / measured - mean.x * mean.x + sum2[i].y / measured - mean.y * mean.y;
+        }
+        stats.repeatability = std::sqrt(std::max(0.0, variance / dots));
+    }
+    return stats;
+}
+
+// Сдвиг сетки от кадра к кадру: полный поиск на каждом кадре против слежения
+void measureTracking(const SyntheticGrid& grid, const camcalib::GridSearchParams& params, int frames) {
+    camcalib::TrackingParams trackingParams;
+    trackingParams.search = params;
+    camcalib::GridTracker tracker(trackingParams);
+    auto fullTime = 0.0;
+    auto trackingTime = 0.0;
+    auto fallbacks = 0;
+    auto errorSum = 0.0;
+    auto compared = 0;
+    for(int frame = 0; frame < frames; frame++) {
+        auto shift = cv::Matx23d(1.0, 0.0, 0.7 * frame, 0.0, 1.0, 0.45 * frame);
+        cv::Mat image;
+        cv::warpAffine(grid.image, image, shift, grid.image.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        auto start = std::chrono::steady_clock::now();
+        auto full = camcalib::findCirclesGrid(image, params);
+        auto middle = std::chrono::steady_clock::now();
+        const auto& tracked = tracker.track(image);
+        auto end = std::chrono::steady_clock::now();
+        fullTime += std::chrono::duration<double, std::milli>(middle - start).count();
+        trackingTime += std::chrono::duration<double, std::milli>(end - middle).count();
+        fallbacks += tracker.isFullDetection() ? 1 : 0;
+        if(full.size() == tracked.size()) {
+            for(size_t i = 0; i < full.size(); i++) {
+                auto dx = full[i][0] - tracked[i][0];
+                auto dy = full[i][1] - tracked[i][1];
+                errorSum += dx * dx + dy * dy;
+                ++compared;
+            }
+        }
+    }
+    std::printf("\ntracking %dx%d, %d frames: full %.3f ms/frame, tracking %.3f ms/frame, "
+                "full detections %d, rms to full %.4f px\n",
+                params.gridSize.width, params.gridSize.height, frames,
+                fullTime / frames, trackingTime / frames, fallbacks,
+                compared > 0 ? std::sqrt(errorSum / compared) : 0.0);
+}
+
+// Плиточный поиск должен давать ту же сетку, что и поиск по всему изображению
+void measureTiling(const SyntheticGrid& grid, const camcalib::GridSearchParams& params, int tileSize) {
+    auto tiledParams = params;
+    tiledParams.mode = camcalib::GridSearchMode::Tiled;
+    tiledParams.tileSize = cv::Size{tileSize, tileSize};
+    tiledParams.tileOverlap = tileSize / 4;
+    auto start = std::chrono::steady_clock::now();
+    auto full = camcalib::findCirclesCentersGrid(grid.image, params);
+    auto middle = std::chrono::steady_clock::now();
+    auto tiled = camcalib::findCirclesCentersGrid(grid.image, tiledParams);
+    auto end = std::chrono::steady_clock::now();
+    auto maxDeviation = 0.0;
+    if(full.size() == tiled.size()) {
+        for(size_t i = 0; i < full.size(); i++) {
+            maxDeviation = std::max(maxDeviation, cv::norm(full[i] - tiled[i]));
+        }
+    }
+    std::printf("tiles %dx%d: full %.3f ms, tiled %.3f ms, points %zu/%zu, max deviation %.6f px\n",
+                tileSize, tileSize,
+                std::chrono::duration<double, std::milli>(middle - start).count(),
+                std::chrono::duration<double, std::milli>(end - middle).count(),
+                tiled.size(), full.size(), maxDeviation);
+}
+
+// Поиск на уровне пирамиды с уточнением против полного разрешения: проверка допуска
+// GridSearchMode::Pyramid, диаметр метки на грубом уровне - 2 * radius / 2^levels
+void measurePyramid(const SyntheticGrid& grid, const camcalib::GridSearchParams& params, int levels) {
+    auto fullParams = params;
+    fullParams.mode = camcalib::GridSearchMode::FullResolution;
+    auto pyramidParams = params;
+    pyramidParams.mode = camcalib::GridSearchMode::Pyramid;
+    pyramidParams.pyramidLevels = levels;
+    std::vector<cv::Point2f> full, pyramid;
+    auto fullTime = medianMilliseconds(5, [&]{
+        full = camcalib::findCirclesCentersGrid(grid.image, fullParams);
+    });
+    auto pyramidTime = medianMilliseconds(5, [&]{
+        pyramid = camcalib::findCirclesCentersGrid(grid.image, pyramidParams);
+    });
+    auto maxDeviation = 0.0;
+    if(full.size() == pyramid.size()) {
+        for(size_t i = 0; i < full.size(); i++) {
+            maxDeviation = std::max(maxDeviation, cv::norm(full[i] - pyramid[i]));
+        }
+    }
+    std::printf("pyramid level %d, coarse dot diameter %.1f px: full %.3f ms, pyramid %.3f ms, "
+                "points %zu/%zu, max deviation %.6f px\n",
+                levels, 2.0 * grid.circles.front()[2] / (1 << levels), fullTime, pyramidTime,
+                pyramid.size(), full.size(), maxDeviation);
+}
+
+// Набор для отслеживания регрессий: время и погрешность основных функций
+// на синтетических мишенях разного размера, результат в JSON
+
+struct SuiteCase {
+    int imageSide;
+    cv::Size gridSize;
+};
+
+struct SuiteResult {
+    std::string function;
+    int imageSide{};
+    cv::Size gridSize;
+    int repeats{};
+    double medianMilliseconds{};
+    double megapixelsPerSecond{};
+    double dotsPerSecond{};
+    double rmsError{};
+    double maxError{};
+    int failures{};
+};
+
+template<typename Callable>
+double medianMilliseconds(int repeats, Callable callable) {
+    std::vector<double> times;
+    for(int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        callable();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+cv::Point2d positionOf(const cv::Point2f& center) {
+    return center;
+}
+
+cv::Point2d positionOf(const cv::Vec3f& circle) {
+    return {circle[0], circle[1]};
+}
+
+template<typename Point>
+void collectErrors(SuiteResult& result, const std::vector<Point>& found, const std::vector<cv::Vec3f>& truth) {
+    if(found.size() != truth.size()) {
+        ++result.failures;
+        return;
+    }
+    auto errorSum = 0.0;
+    for(size_t i = 0; i < found.size(); i++) {
+        auto error = cv::norm(positionOf(found[i]) - positionOf(truth[i]));
+        errorSum += error * error;
+        result.maxError = std::max(result.maxError, error);
+    }
+    result.rmsError = std::sqrt(errorSum / found.size());
+}
+
+camcalib::SyntheticTarget renderSuiteTarget(const SuiteCase& suiteCase) {
+    auto params = camcalib::SyntheticTargetParams{};
+    params.gridSize = suiteCase.gridSize;
+    params.gridStep = 1.0;
+    params.dotRadius = 0.25;
+    params.imageSize = cv::Size{suiteCase.imageSide, suiteCase.imageSide};
+    params.pixelSize = (std::max(params.gridSize.width, params.gridSize.height) + 1.0) / suiteCase.imageSide;
+    // Поворот меньше, чем допускает упорядочивание по строкам
+    params.rotation = 0.005;
+    params.blurSigma = 1.0;
+    params.noiseSigma = 2.0;
+    params.vignetting = 0.2;
+    // Смещение в углу изображения около половины пиксела
+    auto corner = 0.7 * suiteCase.imageSide;
+    params.distortion.center = cv::Point2d(0.5 * suiteCase.imageSide, 0.5 * suiteCase.imageSide);
+    params.distortion.k1 = 0.5 / (corner * corner * corner);
+    return camcalib::renderSyntheticTarget(params);
+}
+
+std::vector<SuiteResult> runSuiteCase(const SuiteCase& suiteCase) {
+    auto target = renderSuiteTarget(suiteCase);
+    auto params = camcalib::GridSearchParams{};
+    params.gridSize = suiteCase.gridSize;
+    params.edgeStrength = 100.0;
+    const auto repeats = suiteCase.imageSide > 2048 ? 3 : 7;
+    const auto megapixels = target.image.total() * 1e-6;
+    const auto dots = static_cast<double>(target.circlesImage.size());
+    auto makeResult = [&](std::string function, double milliseconds) {
+        auto result = SuiteResult{};
+        result.function = std::move(function);
+        result.imageSide = suiteCase.imageSide;
+        result.gridSize = suiteCase.gridSize;
+        result.repeats = repeats;
+        result.medianMilliseconds = milliseconds;
+        result.megapixelsPerSecond = megapixels * 1000.0 / milliseconds;
+        result.dotsPerSecond = dots * 1000.0 / milliseconds;
+        return result;
+    };
+    std::vector<SuiteResult> results;
+
+    std::vector<cv::Point2f> centers;
+    auto time = medianMilliseconds(repeats, [&]{
+        centers = camcalib::findCirclesCentersGrid(target.image, params);
+    });
+    results.push_back(makeResult("findCirclesCentersGrid", time));
+    collectErrors(results.back(), centers, target.circlesImage);
+
+    std::vector<cv::Vec3f> circles;
+    time = medianMilliseconds(repeats, [&]{
+        circles = camcalib::findCirclesGrid(target.image, params);
+    });
+    results.push_back(makeResult("findCirclesGrid", time));
+    collectErrors(results.back(), circles, target.circlesImage);
+
+    // Точки края с шумом 0.05 пикс для каждой метки
+    constexpr auto SamplesPerCircle = 64;
+    cv::RNG rng(54321);
+    std::vector<std::vector<cv::Point2f>> edgeSamples;
+    for(const auto& circle: target.circlesImage) {
+        std::vector<cv::Point2f> samples;
+        for(int i = 0; i < SamplesPerCircle; i++) {
+            auto angle = CV_2PI * i / SamplesPerCircle;
+            samples.emplace_back(circle[0] + circle[2] * std::cos(angle) + rng.gaussian(0.05),
+                                 circle[1] + circle[2] * std::sin(angle) + rng.gaussian(0.05));
+        }
+        edgeSamples.push_back(std::move(samples));
+    }
+    std::vector<cv::Vec3f> fitted(edgeSamples.size());
+    time = medianMilliseconds(repeats, [&]{
+        std::transform(edgeSamples.begin(), edgeSamples.end(), fitted.begin(), [](const auto& samples){
+            return camcalib::fitCircleCeres(samples).value_or(cv::Vec3f{});
+        });
+    });
+    results.push_back(makeResult("fitCircleCeres", time));
+    collectErrors(results.back(), fitted, target.circlesImage);
+
+    camcalib::PointSets sets;
+    for(const auto& samples: edgeSamples) {
+        sets.add(cv::Mat(samples));
+    }
+    time = medianMilliseconds(repeats, [&]{
+        fitted = camcalib::fitCircles(sets);
+    });
+    results.push_back(makeResult("fitCircles", time));
+    collectErrors(results.back(), fitted, target.circlesImage);
+
+    // Погрешность калибровки - относительная ошибка размера пиксела
+    std::optional<cv::Matx33f> cameraMatrix;
+    auto detected = centers.size() == target.centersWorld.size() ? centers : std::vector<cv::Point2f>{};
+    time = medianMilliseconds(repeats, [&]{
+        cameraMatrix = camcalib::calibrate(detected, target.centersWorld);
+    });
+    results.push_back(makeResult("calibrate", time));
+    const auto pixelSize = std::hypot(target.imageToWorld(0, 0), target.imageToWorld(0, 1));
+    if(cameraMatrix && !detected.empty()) {
+        auto errorX = std::abs((*cameraMatrix)(0, 0) * pixelSize - 1.0);
+        auto errorY = std::abs((*cameraMatrix)(1, 1) * pixelSize - 1.0);
+        results.back().rmsError = std::sqrt(0.5 * (errorX * errorX + errorY * errorY));
+        results.back().maxError = std::max(errorX, errorY);
+    } else {
+        ++results.back().failures;
+    }
+
+    // Несколько кадров мишени под разными углами (допустимы при --partial):
+    // поворот кадра не должен уменьшать общий масштаб
+    std::vector<std::vector<cv::Point2f>> rotatedFrames;
+    for(auto degrees: {-10.0, 0.0, 10.0, 25.0}) {
+        auto angle = degrees * CV_PI / 180.0;
+        auto c = std::cos(angle) / pixelSize;
+        auto s = std::sin(angle) / pixelSize;
+        std::vector<cv::Point2f> frame;
+        for(const auto& w: target.centersWorld) {
+            frame.emplace_back(static_cast<float>(c * w.x - s * w.y + 0.3 * suiteCase.imageSide + rng.gaussian(0.05)),
+                               static_cast<float>(s * w.x + c * w.y + 0.2 * suiteCase.imageSide + rng.gaussian(0.05)));
+        }
+        rotatedFrames.push_back(std::move(frame));
+    }
+    std::optional<cv::Size2d> pooledPixelSize;
+    time = medianMilliseconds(repeats, [&]{
+        camcalib::PixelSizeEstimator estimator;
+        for(const auto& frame: rotatedFrames) {
+            estimator.addFrame(frame, target.centersWorld);
+        }
+        pooledPixelSize = estimator.pixelSize();
+    });
+    results.push_back(makeResult("PixelSizeEstimator rotated", time));
+    if(pooledPixelSize) {
+        auto errorX = std::abs(pooledPixelSize->width / pixelSize - 1.0);
+        auto errorY = std::abs(pooledPixelSize->height / pixelSize - 1.0);
+        results.back().rmsError = std::sqrt(0.5 * (errorX * errorX + errorY * errorY));
+        results.back().maxError = std::max(errorX, errorY);
+    } else {
+        ++results.back().failures;
+    }
+    return results;
+}
+
+bool runSuite(const std::string& filename) {
+    const std::vector<SuiteCase> cases = {
+        {1024, {10, 10}}, {1024, {20, 20}},
+        {2048, {10, 10}}, {2048, {20, 20}}, {2048, {40, 40}},
+        {4096, {20, 20}}, {4096, {40, 40}}, {4096, {80, 80}},
+    };
+    cv::FileStorage storage(filename, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+    if(!storage.isOpened()) {
+        std::fprintf(stderr, "can't open %s\n", filename.c_str());
+        return false;
+    }
+    storage << "opencv" << CV_VERSION;
+    storage << "threads" << static_cast<int>(std::thread::hardware_concurrency());
+    storage << "results" << "[";
+    for(const auto& suiteCase: cases) {
+        for(const auto& result: runSuiteCase(suiteCase)) {
+            std::fprintf(stderr, "%-24s %5d px %3dx%-3d %10.3f ms %8.4f rms %d failed\n",
+                         result.function.c_str(), result.imageSide,
+                         result.gridSize.width, result.gridSize.height,
+                         result.medianMilliseconds, result.rmsError, result.failures);
+            // Погрешность calibrate и PixelSizeEstimator относительная, остальных функций - в пикселах
+            storage << "{"
+                    << "function" << result.function
+                    << "image_width" << result.imageSide
+                    << "image_height" << result.imageSide
+                    << "grid_width" << result.gridSize.width
+                    << "grid_height" << result.gridSize.height
+                    << "repeats" << result.repeats
+                    << "median_ms" << result.medianMilliseconds
+                    << "megapixels_per_s" << result.megapixelsPerSecond
+                    << "dots_per_s" << result.dotsPerSecond
+                    << "rms_error" << result.rmsError
+                    << "max_error" << result.maxError
+                    << "failures" << result.failures
+                    << "}";
+        }
+    }
+    storage << "]";
+    storage.release();
+    return true;
+}
+
+// Исправление дисторсии кадра 20 Мп: построение таблицы, remap 8 и 16 бит,
+// отклонение интерполированной таблицы от точного решения
+void measureUndistortion(cv::Size imageSize) {
+    auto distortion = camcalib::LensDistortion{};
+    distortion.center = cv::Point2d(0.5 * imageSize.width, 0.5 * imageSize.height);
+    auto corner = distortion.center.dot(distortion.center);
+    // Около 5 пикселов сдвига в углу
+    distortion.k1 = 5.0 / (corner * std::sqrt(corner));
+    distortion.p1 = 1.0 / corner;
+    auto start = std::chrono::steady_clock::now();
+    auto map = camcalib::makeUndistortionMap(distortion, imageSize);
+    auto buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    auto maxDeviation = 0.0;
+    for(int y = 0; y < imageSize.height; y += 97) {
+        for(int x = 0; x < imageSize.width; x += 89) {
+            auto exact = camcalib::distortPoint(distortion, cv::Point2d(x, y));
+            auto index = map.map2.at<ushort>(y, x);
+            auto base = map.map1.at<cv::Vec2s>(y, x);
+            auto mapped = cv::Point2d(base[0] + (index % cv::INTER_TAB_SIZE) / double(cv::INTER_TAB_SIZE),
+                                      base[1] + (index / cv::INTER_TAB_SIZE) / double(cv::INTER_TAB_SIZE));
+            maxDeviation = std::max(maxDeviation, cv::norm(mapped - exact));
+        }
+    }
+    std::printf("undistortion %dx%d: map %.1f ms, max deviation %.4f px", imageSize.width, imageSize.height,
+                buildTime, maxDeviation);
+    for(auto depth: {CV_8U, CV_16U}) {
+        cv::Mat src(imageSize, depth);
+        cv::randu(src, 0, depth == CV_8U ? 255 : 65535);
+        cv::Mat dst;
+        camcalib::undistortImage(src, dst, map);
+        auto remapTime = medianMilliseconds(10, [&]{
+            camcalib::undistortImage(src, dst, map);
+        });
+        std::printf(", remap %d bit %.1f ms", depth == CV_8U ? 8 : 16, remapTime);
+    }
+    std::printf("\n");
+}
+
+// Повторный поиск с кэшем этапов: те же параметры, другой размер сетки и другой ROI.
+// Результаты с кэшем сравниваются с поиском без кэша с теми же параметрами.
+void measureDetectionCache(const SyntheticGrid& grid, const camcalib::GridSearchParams& params) {
+    auto cachedParams = params;
+    cachedParams.cache = std::make_shared<camcalib::DetectionCache>(grid.image);
+    auto smallerGridParams = cachedParams;
+    smallerGridParams.gridSize = cv::Size{params.gridSize.width - 1, params.gridSize.height - 1};
+    auto roiParams = cachedParams;
+    roiParams.imageROI = cv::Rect(2, 2, grid.image.cols - 4, grid.image.rows - 4);
+    auto uncachedRoiParams = roiParams;
+    uncachedRoiParams.cache.reset();
+    auto uncachedTime = medianMilliseconds(10, [&]{
+        camcalib::findCirclesGrid(grid.image, params);
+    });
+    auto start = std::chrono::steady_clock::now();
+    auto first = camcalib::findCirclesGrid(grid.image, cachedParams);
+    auto firstTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    auto cachedTime = medianMilliseconds(10, [&]{
+        camcalib::findCirclesGrid(grid.image, cachedParams);
+    });
+    auto gridChangedTime = medianMilliseconds(10, [&]{
+        camcalib::findCirclesGrid(grid.image, smallerGridParams);
+    });
+    auto roi = camcalib::findCirclesGrid(grid.image, roiParams);
+    auto maxDeviation = [](const std::vector<cv::Vec3f>& found, const std::vector<cv::Vec3f>& reference) {
+        if(found.size() != reference.size()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        auto deviation = 0.0;
+        for(size_t i = 0; i < found.size(); i++) {
+            deviation = std::max(deviation, cv::norm(found[i] - reference[i]));
+        }
+        return deviation;
+    };
+    auto reference = camcalib::findCirclesGrid(grid.image, params);
+    auto roiReference = camcalib::findCirclesGrid(grid.image, uncachedRoiParams);
+    std::printf("detection cache: uncached %.3f ms, first %.3f ms, repeated %.3f ms, grid changed %.3f ms, "
+                "points %zu/%zu, max deviation %.6f px, roi changed max deviation %.6f px, %zu bytes\n",
+                uncachedTime, firstTime, cachedTime, gridChangedTime, first.size(), reference.size(),
+                maxDeviation(first, reference), maxDeviation(roi, roiReference),
+                cachedParams.cache->getMemoryUsage());
+}
+
+// Пересчет координат пиксел - мир для массива точек кадра 20 Мп: пропускная способность,
+// отклонение от undistortPoint в double и ошибка обратного преобразования
+void measurePixelWorldTransform(cv::Size imageSize, size_t count) {
+    auto distortion = camcalib::LensDistortion{};
+    distortion.center = cv::Point2d(0.5 * imageSize.width + 3.0, 0.5 * imageSize.height - 2.0);
+    auto corner = distortion.center.dot(distortion.center);
+    distortion.k1 = 5.0 / (corner * std::sqrt(corner));
+    distortion.p1 = 1.0 / corner;
+    const auto pixelSize = cv::Size2d{0.00121, 0.00119};
+    const auto origin = cv::Point2d(0.5 * imageSize.width, 0.5 * imageSize.height);
+    auto transform = camcalib::PixelWorldTransform{pixelSize, origin, distortion};
+    cv::RNG rng(3);
+    std::vector<cv::Point2f> pixels(count);
+    for(auto& p: pixels) {
+        p = cv::Point2f(rng.uniform(0.0f, float(imageSize.width)), rng.uniform(0.0f, float(imageSize.height)));
+    }
+    std::vector<cv::Point2f> world(count), back(count);
+    auto forwardTime = medianMilliseconds(5, [&]{
+        transform.pixelToWorld(pixels.data(), world.data(), count);
+    });
+    auto inverseTime = medianMilliseconds(5, [&]{
+        transform.worldToPixel(world.data(), back.data(), count);
+    });
+    auto maxDeviation = 0.0;
+    auto maxRoundTrip = 0.0;
+    for(size_t i = 0; i < count; i += 101) {
+        auto undistorted = camcalib::undistortPoint(distortion, pixels[i]) - origin;
+        auto exact = cv::Point2d(undistorted.x * pixelSize.width, undistorted.y * pixelSize.height);
+        maxDeviation = std::max(maxDeviation, cv::norm(cv::Point2d(world[i]) - exact));
+        maxRoundTrip = std::max(maxRoundTrip, cv::norm(cv::Point2d(back[i] - pixels[i])));
+    }
+    std::printf("pixel to world, %zu points: forward %.1f Mpoints/s, inverse %.1f Mpoints/s, "
+                "max deviation %.3g, round trip %.4f px\n",
+                count, count / (1000.0 * forwardTime), count / (1000.0 * inverseTime),
+                maxDeviation, maxRoundTrip);
+}
+
+// Оптический центр по окружностям с известным центром масштабирования
+void measureOpticalCenter(int magnifications) {
+    const auto center = cv::Point2d(812.3, 455.7);
+    const auto reference = cv::Vec3f(300.0f, 200.0f, 40.0f);
+    cv::RNG rng(7);
+    std::vector<cv::Vec3f> circles{reference};
+    for(int i = 1; i <= magnifications; i++) {
+        auto scale = 1.0 + 0.25 * i;
+        circles.emplace_back(static_cast<float>(scale * reference[0] + (1.0 - scale) * center.x + rng.gaussian(0.2)),
+                             static_cast<float>(scale * reference[1] + (1.0 - scale) * center.y + rng.gaussian(0.2)),
+                             static_cast<float>(scale * reference[2] + rng.gaussian(0.05)));
+    }
+    std::optional<camcalib::OpticalCenterSolution> solution;
+    auto time = medianMilliseconds(100, [&]{
+        solution = camcalib::findOpticalCenter(circles);
+    });
+    if(!solution) {
+        std::printf("optical center: FAILED\n");
+        return;
+    }
+    std::printf("optical center, %d magnifications: %.2f us, error %.3f px, deviation (%.3f, %.3f) px\n",
+                magnifications, 1000.0 * time, cv::norm(solution->center - center),
+                std::sqrt(solution->covariance(0, 0)), std::sqrt(solution->covariance(1, 1)));
+}
+}
+
+int main(int argc, char* argv[]) {
+    // CalibrationBenchmark --json <file> - только набор для отслеживания регрессий
+    if(argc == 3 && std::strcmp(argv[1], "--json") == 0) {
+        return runSuite(argv[2]) ? 0 : 1;
+    }
+    const auto gridSize = cv::Size{20, 20};
+    const auto trials = 20;
+    std::printf("%-10s %-8s %-6s %10s %10s %10s %12s %8s\n",
+                "method", "radius", "noise", "ms/image", "us/dot", "rms, px", "repeat, px", "failed");
+    for(auto radius: {6.0, 15.0, 40.0}) {
+        auto grid = renderGrid(gridSize, 4.0 * radius, radius, 1.0);
+        for(auto noise: {0.0, 4.0}) {
+            for(auto method: {camcalib::CircleFitMethod::Ellipse,
+                              camcalib::CircleFitMethod::GradientWeighted,
+                              camcalib::CircleFitMethod::Geometric}) {
+                auto params = camcalib::GridSearchParams{};
+                params.gridSize = gridSize;
+                params.edgeStrength = 100.0;
+                params.fitMethod = method;
+                auto stats = measure(grid, params, noise, trials);
+                std::printf("%-10s %-8.1f %-6.1f %10.3f %10.3f %10.4f %12.4f %8d\n",
+                            methodName(method),
+                            radius, noise,
+                            stats.millisecondsPerImage,
+                            stats.microsecondsPerDot,
+                            stats.rmsError,
+                            stats.repeatability,
+                            stats.failures);
+            }
+        }
+    }
+    auto trackingGrid = renderGrid(gridSize, 24.0, 6.0, 1.0);
+    auto trackingParams = camcalib::GridSearchParams{};
+    trackingParams.gridSize = gridSize;
+    trackingParams.edgeStrength = 100.0;
+    measureTracking(trackingGrid, trackingParams, 50);
+    measureTiling(trackingGrid, trackingParams, 256);
+    auto pyramidGrid = renderGrid(gridSize, 64.0, 16.0, 1.0);
+    for(auto levels: {1, 2}) {
+        measurePyramid(pyramidGrid, trackingParams, levels);
+    }
+    measureUndistortion(cv::Size{5472, 3648});
+    measureOpticalCenter(10);
+    measureDetectionCache(trackingGrid, trackingParams);
+    measurePixelWorldTransform(cv::Size{5472, 3648}, 1000000);
+    return 0;
+}
@@ -1,14 +1,23 @@
 #include "Calibration.h"
+#include "CircleFit.h"
+#include "DetectionCache.h"
+#include "EdgeComponents.h"
+#include "MappedImage.h"
+#include "PixelSizeEstimator.h"
+#include "Trace.h"
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <iostream>
 #include <algorithm>
 #include <execution>
+#include <limits>
+#include <type_traits>
 
 namespace camcalib {
 
 template<typename T>
 static std::vector<T> sortGrid(std::vector<T> points, const cv::Size& patternSize) {
+    CAMCALIB_TRACE_SCOPE("sortGrid");
     if(points.size() != patternSize.area()) {
         std::cerr << __FUNCTION__": Grid size mismatch: "
                   << patternSize
@@ -38,41 +47,115 @@ static std::vector<T> sortGrid(std::vector<T> points, const cv::Size& patternSiz
     return points;
 }
 
-static inline auto fitCircle(const std::vector<cv::Point2f>& points, const cv::Point2f& offset = {}) {  
+static inline auto fitCircle(const cv::Mat& points, const cv::Point2f& offset = {}) {
+    CAMCALIB_TRACE_SCOPE("fitEllipse");
     try {
         auto ellipse = cv::fitEllipse(points);
         auto [x, y] = ellipse.center + cv::Point2f(offset);
         auto r = (ellipse.size.width + ellipse.size.height) / 4.0f;
         return cv::Vec3f{x, y, r};
-    } catch(std::runtime_error& err) {
+    } catch(const cv::Exception& err) {
         std::cerr << __FUNCTION__": " << err.what() << std::endl;
         return cv::Vec3f{};
     }
 }
 
-static inline auto makeCircleSearcher(cv::Mat edges) {
-    return [=](const cv::Rect& roi) {
-        std::vector<cv::Point2f> edgePoints;
-        cv::findNonZero(edges(roi), edgePoints);
-        return fitCircle(edgePoints, roi.tl());
+// Фабрики функций поиска окружности по компоненте краев.
+// image - область, в которой размечены компоненты, offset - ее положение на исходном изображении.
+static inline auto makeCircleSearcher(const cv::Mat& /*image*/, cv::Point offset) {
+    return [offset](const EdgeComponent& component) {
+        return fitCircle(component.points, offset);
     };
 }
 
-static inline auto makeCircleCenterSearcher(cv::Mat edges) {
-    auto circleSearcher = makeCircleSearcher(std::move(edges));
-    return [circleSearcher](const cv::Rect& roi) {
-        auto circle = circleSearcher(roi);
-        return cv::Point2f(circle[0], circle[1]);
+// Окно вокруг компоненты краев, чтобы в него попал весь перепад яркости
+constexpr auto GradientPatchMargin = 2;
+
+static inline auto makeGradientCircleSearcher(const GridSearchParams& params) {
+    // Верхний порог Кэнни задан для оператора Собеля (примерно вчетверо больше
+    // центральной разности), берется половина, чтобы учесть склоны перепада
+    auto minGradient = static_cast<float>(params.edgeStrength / 8.0);
+    return [minGradient](const cv::Mat& image, cv::Point offset) {
+        return [image, offset, minGradient](const EdgeComponent& component) {
+            const auto& roi = component.rect;
+            auto patch = cv::Rect(roi.x - GradientPatchMargin,
+                                  roi.y - GradientPatchMargin,
+                                  roi.width + 2 * GradientPatchMargin,
+                                  roi.height + 2 * GradientPatchMargin);
+            patch &= cv::Rect(1, 1, image.cols - 2, image.rows - 2);
+            if(auto circle = fitCircleGradient(image, patch, minGradient)) {
+                return cv::Vec3f{(*circle)[0] + offset.x, (*circle)[1] + offset.y, (*circle)[2]};
+            }
+            return cv::Vec3f{};
+        };
+    };
+}
+
+// Геометрическая подгонка (fitCircles): все компоненты сетки подгоняются одним пакетом
+struct GeometricCircleSearcher {
+    cv::Point offset;
+
+    cv::Vec3f operator()(const EdgeComponent& component) const {
+        return (*this)(std::vector<EdgeComponent>{component}).front();
+    }
+    std::vector<cv::Vec3f> operator()(const std::vector<EdgeComponent>& components) const {
+        PointSets sets;
+        for(const auto& component: components) {
+            sets.add(component.points);
+        }
+        auto circles = fitCircles(sets);
+        for(auto& circle: circles) {
+            if(circle[2] > 0.0f) {
+                circle[0] += offset.x;
+                circle[1] += offset.y;
+            }
+        }
+        return circles;
+    }
+};
+
+static inline auto makeGeometricCircleSearcher(const cv::Mat& /*image*/, cv::Point offset) {
+    return GeometricCircleSearcher{offset};
+}
+
+static inline cv::Point2f toCenters(const cv::Vec3f& circle) {
+    return {circle[0], circle[1]};
+}
+
+static inline std::vector<cv::Point2f> toCenters(const std::vector<cv::Vec3f>& circles) {
+    std::vector<cv::Point2f> centers(circles.size());
+    std::transform(circles.begin(), circles.end(), centers.begin(), [](const auto& circle){
+        return toCenters(circle);
+    });
+    return centers;
+}
+
+// Пакетная подгонка сохраняется, если ее поддерживает функция поиска окружности
+template<typename CircleSearcherFactory>
+static inline auto makeCenterSearcher(CircleSearcherFactory makeSearcher) {
+    return [makeSearcher](const cv::Mat& image, cv::Point offset) {
+        auto circleSearcher = makeSearcher(image, offset);
+        return [circleSearcher](const auto& components) -> decltype(toCenters(circleSearcher(components))) {
+            return toCenters(circleSearcher(components));
+        };
     };
 }
 
-static inline auto getComponentRect(const cv::Mat& stats, int componentIndex) {
-    return cv::Rect(
-        stats.at<int32_t>(componentIndex, cv::CC_STAT_LEFT),
-        stats.at<int32_t>(componentIndex, cv::CC_STAT_TOP),
-        stats.at<int32_t>(componentIndex, cv::CC_STAT_WIDTH),
-        stats.at<int32_t>(componentIndex, cv::CC_STAT_HEIGHT)
-        );
+// Функции с перегрузкой для std::vector<EdgeComponent> подгоняют все компоненты сразу,
+// остальные вызываются для каждой компоненты параллельно
+template<typename Fit>
+static auto fitCandidates(const Fit& fit, const std::vector<EdgeComponent>& candidates) {
+    if constexpr (std::is_invocable_v<const Fit&, const std::vector<EdgeComponent>&>) {
+        return fit(candidates);
+    } else {
+        std::vector<decltype(fit(EdgeComponent{}))> centers(candidates.size());
+        std::transform(std::execution::par,
+                       candidates.begin(),
+                       candidates.end(),
+                       centers.begin(),
+                       fit);
+        return centers;
+    }
 }
 
 static inline auto isValidComponent(const cv::Rect& componentRect, const std::optional<cv::Rect>& roi) {
@@ -85,40 +168,7 @@ static inline auto isValidComponent(const cv::Rect& componentRect, const std::op
     return true;
 }
 
-// P = \ p11 p12 p13 \
-//     \ p21 p22 p23 \
-// uv_image = P * xy_world
-static std::optional<cv::Matx23f> makeProjectionMatrix(const std::vector<cv::Point2f> &centersImage,
-                                                       const std::vector<cv::Point2f> &centersWorld) {
-    if(centersImage.size() != centersWorld.size()) {
-        return std::nullopt;
-    }
-    const auto rows = 2 * static_cast<int>(centersWorld.size());
-    auto rhs = cv::Mat(centersImage).reshape(1, rows);
-    auto lhs = cv::Mat(rows, 6, CV_32F);
-    for(auto r = 0; r < centersWorld.size(); r++) {
-        auto [x, y] = centersWorld[r];
-        cv::Mat(cv::Matx16f(x, y, 1.0f, 0.0f, 0.0f ,0.0f), false)
-            .copyTo(lhs.row(2 * r));
-        cv::Mat(cv::Matx16f(0.0f, 0.0f, 0.0f, x, y, 1.0f), false)
-            .copyTo(lhs.row(2 * r + 1));
-    }
-    if(cv::Matx61f proj; cv::solve(lhs, rhs, proj, cv::DECOMP_NORMAL)) {
-        return cv::Matx23f(proj(0), proj(1), proj(2),
-                           proj(3), proj(4), proj(5));
-    } else {        
-        std::cerr << __FUNCTION__": can't find least squares projection matrix" << std::endl;
-    }
-    return std::nullopt;
-}
-
-static inline auto toMatx33f(const cv::Matx23f& mat) {
-    return cv::Matx33f(mat(0, 0), mat(0, 1), mat(0, 2),
-                       mat(1, 0), mat(1, 1), mat(1, 2),
-                       0.0f, 0.0f, 1.0f);
-}
-
-static auto factorizeCameraMatrix(const cv::Matx33d& matrix) {
+std::pair<cv::Matx33d, cv::Matx33d> factorizeCameraMatrix(const cv::Matx33d& matrix) {
     /*
      *     \ mx alpha 0.0 \
      * F = \ 0.0 my   0.0 \
@@ -146,68 +196,817 @@ static auto factorizeCameraMatrix(const cv::Matx33d& matrix) {
     return std::pair{f, r};
 }
 
-static cv::Matx23f makeNormalizationMatrix(const std::vector<cv::Point2f> &points) {
-    assert(!points.empty());
-    auto mean = cv::mean(points);
-    auto center = cv::Point2d(mean(0), mean(1));
-    auto distanceSum = std::accumulate(points.begin(),
-                                       points.end(),
-                                       0.0,
-                                       [center](double acc, const cv::Point2d& p){
-                                           return acc + cv::norm<double>(p - center);
-                                       });
-    auto scale = static_cast<float>(std::sqrt(2.0) * points.size() / distanceSum);
-    return cv::Matx23f(
-        scale, 0.0f, -scale * static_cast<float>(center.x),
-        0.0f, scale, -scale * static_cast<float>(center.y));
-}
-
-static std::vector<cv::Rect> findCandidateRectangles(const cv::Mat& edges, const GridSearchParams& params) {
-    cv::Mat labels, stats, centroids;
-    auto components = cv::connectedComponentsWithStats(edges, labels, stats, centroids);
-    std::vector<cv::Rect> result;
-    for(int i = 1; i < components; i++) {
-        if(auto rect = getComponentRect(stats, i); isValidComponent(rect, params.imageROI)) {
-            result.push_back(rect);
+enum class CandidateSelection {
+    // gridSize.area() компонент наибольшей площади
+    Largest,
+    // Все компоненты, площадь которых близка к медианной, число меток заранее неизвестно
+    MedianArea,
+    // Largest, если компонент не меньше gridSize.area(), иначе MedianArea
+    LargestOrMedianArea
+};
+
+static std::vector<size_t> selectByMedianArea(const EdgeComponents& components, std::vector<size_t> indices) {
+    if(indices.empty()) {
+        return {};
+    }
+    std::vector<int> areas(indices.size());
+    std::transform(indices.begin(), indices.end(), areas.begin(), [&](size_t i){
+        return components.rects[i].area();
+    });
+    auto median = areas.begin() + areas.size() / 2;
+    std::nth_element(areas.begin(), median, areas.end());
+    auto minArea = *median / 4;
+    auto maxArea = *median * 4;
+    indices.erase(std::remove_if(indices.begin(), indices.end(), [&](size_t i){
+        auto area = components.rects[i].area();
+        return area < minArea || area > maxArea;
+    }), indices.end());
+    return indices;
+}
+
+// Индексы компонент-кандидатов, offset - положение разметки на исходном изображении
+static std::vector<size_t> selectCandidates(const EdgeComponents& components,
+                                            const GridSearchParams& params,
+                                            const cv::Point& offset,
+                                            CandidateSelection selection) {
+    std::vector<size_t> result;
+    for(size_t i = 0; i < components.size(); i++) {
+        if(isValidComponent(components.rects[i] + offset, params.imageROI)) {
+            result.push_back(i);
         }
     }
-    if(params.gridSize.area() > result.size()) {
+    auto gridArea = static_cast<size_t>(params.gridSize.area());
+    if(selection == CandidateSelection::LargestOrMedianArea) {
+        selection = gridArea > 0 && gridArea <= result.size()
+            ? CandidateSelection::Largest
+            : CandidateSelection::MedianArea;
+    }
+    if(selection == CandidateSelection::MedianArea) {
+        return selectByMedianArea(components, std::move(result));
+    }
+    if(gridArea > result.size()) {
         std::cerr << __FUNCTION__" count of components too small" << std::endl;
         return {};
     }
-    std::sort(result.begin(), result.end(), [](const auto& r1, const auto& r2){
-        return r1.area() > r2.area();
+    std::sort(result.begin(), result.end(), [&](size_t i1, size_t i2){
+        return components.rects[i1].area() > components.rects[i2].area();
     });
-    result.erase(result.begin() + params.gridSize.area(), result.end());
+    result.resize(gridArea);
     return result;
 }
 
+// Компоненты возвращаются в координатах разметки, offset - ее положение на исходном изображении
+static std::vector<EdgeComponent> findCandidateComponents(const EdgeComponents& components,
+                                                          const GridSearchParams& params,
+                                                          const cv::Point& offset,
+                                                          CandidateSelection selection) {
+    std::vector<EdgeComponent> result;
+    for(auto i: selectCandidates(components, params, offset, selection)) {
+        result.push_back(components[i]);
+    }
+    return result;
+}
+
+// Запас вокруг области поиска, чтобы градиент и подавление немаксимумов
+// на ее границе считались так же, как на полном изображении
+constexpr auto SearchHalo = 2;
+
+static cv::Rect makeSearchRect(const cv::Size& imageSize, const std::optional<cv::Rect>& roi) {
+    auto imageRect = cv::Rect(cv::Point{}, imageSize);
+    if(!roi) {
+        return imageRect;
+    }
+    auto searchRect = cv::Rect(roi->x - SearchHalo,
+                               roi->y - SearchHalo,
+                               roi->width + 2 * SearchHalo,
+                               roi->height + 2 * SearchHalo);
+    return searchRect & imageRect;
+}
+
+// Минимум и максимум яркости области rect полосами по StripRows строк: 16-битные данные
+// с обратным порядком байтов переставляются по одной полосе, область целиком не копируется
+static cv::Vec2d findIntensityRange(const cv::Mat& image, const cv::Rect& rect, bool swappedByteOrder) {
+    constexpr auto StripRows = 256;
+    std::vector<cv::Rect> strips;
+    for(int y = rect.y; y < rect.br().y; y += StripRows) {
+        strips.emplace_back(rect.x, y, rect.width, std::min(StripRows, rect.br().y - y));
+    }
+    std::vector<cv::Vec2d> ranges(strips.size());
+    std::transform(std::execution::par,
+                   strips.begin(),
+                   strips.end(),
+                   ranges.begin(),
+                   [&image, swappedByteOrder](const cv::Rect& strip) {
+                       auto range = cv::Vec2d{};
+                       cv::minMaxLoc(toHostByteOrder(image, strip, swappedByteOrder), &range[0], &range[1]);
+                       return range;
+                   });
+    auto result = cv::Vec2d(std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest());
+    for(const auto& range: ranges) {
+        result[0] = std::min(result[0], range[0]);
+        result[1] = std::max(result[1], range[1]);
+    }
+    return result;
+}
+
+GridSearchParams withIntensityRange(const cv::Mat& image, GridSearchParams params) {
+    if(image.depth() == CV_16U && !params.intensityRange) {
+        params.intensityRange = findIntensityRange(image, makeSearchRect(image.size(), params.imageROI),
+                                                   params.swappedByteOrder);
+    }
+    return params;
+}
+
+// Область rect 16-битного изображения в 8 бит: диапазон яркости один для всех плиток
+// и окон, поэтому edgeStrength означает один и тот же перепад яркости
+static cv::Mat convertTo8Bit(const cv::Mat& image, const cv::Rect& rect, const GridSearchParams& params) {
+    auto range = params.intensityRange ? *params.intensityRange : *withIntensityRange(image, params).intensityRange;
+    auto scale = range[1] > range[0] ? 255.0 / (range[1] - range[0]) : 0.0;
+    cv::Mat converted;
+    toHostByteOrder(image, rect, params.swappedByteOrder).convertTo(converted, CV_8U, scale, -range[0] * scale);
+    return converted;
+}
+
+// Исключенная область накрывает rect целиком: края в нем не ищутся
+static bool isExcluded(const cv::Rect& rect, const std::vector<cv::Rect>& excludedRegions) {
+    return std::any_of(excludedRegions.begin(), excludedRegions.end(), [&rect](const cv::Rect& region){
+        return (rect & region) == rect;
+    });
+}
+
+// Края Кэнни вне исключенных областей (координаты областей со смещением offset).
+// Пикселы областей заменяются постоянной яркостью до Кэнни, поэтому текстура в них
+// не порождает края и компоненты; ступенька яркости на границе области подавляется
+// вместе с окрестностью в 1 пикс.
+static void findEdges(const cv::Mat& image,
+                      cv::Mat& edges,
+                      double edgeStrength,
+                      const std::vector<cv::Rect>& excludedRegions,
+                      const cv::Point& offset) {
+    auto imageRect = cv::Rect(cv::Point{}, image.size());
+    std::vector<cv::Rect> rects;
+    for(const auto& region: excludedRegions) {
+        if(auto rect = (region - offset) & imageRect; !rect.empty()) {
+            rects.push_back(rect);
+        }
+    }
+    if(rects.empty()) {
+        cv::Canny(image, edges, 0, edgeStrength);
+        return;
+    }
+    auto masked = image.clone();
+    for(const auto& rect: rects) {
+        masked(rect).setTo(0);
+    }
+    cv::Canny(masked, edges, 0, edgeStrength);
+    for(const auto& rect: rects) {
+        edges(cv::Rect(rect.x - 1, rect.y - 1, rect.width + 2, rect.height + 2) & imageRect).setTo(0);
+    }
+}
+
+static cv::Rect scaleRect(const cv::Rect& rect, double scale, bool outward) {
+    if(outward) {
+        return cv::Rect(cv::Point(cvFloor(rect.x * scale), cvFloor(rect.y * scale)),
+                        cv::Point(cvCeil(rect.br().x * scale), cvCeil(rect.br().y * scale)));
+    }
+    return cv::Rect(cv::Point(cvCeil(rect.x * scale), cvCeil(rect.y * scale)),
+                    cv::Point(cvFloor(rect.br().x * scale), cvFloor(rect.br().y * scale)));
+}
+
+// Поиск одной метки в окне полного разрешения: выбирается наибольшая компонента окна
 template<typename Callable>
-static inline auto findGrid(const cv::Mat& image, const GridSearchParams& params, Callable fitFunction) {
-    assert(!params.gridSize.empty());
+static auto fitInWindow(const cv::Mat& image,
+                        const cv::Rect& window,
+                        const GridSearchParams& params,
+                        Callable fitFunction)
+    -> std::optional<decltype(fitFunction(cv::Mat{}, cv::Point{})(EdgeComponent{}))> {
+    CAMCALIB_TRACE_SCOPE("fitInWindow");
+    if(isExcluded(window, params.excludedRegions)) {
+        return std::nullopt;
+    }
+    cv::Mat edges;
+    findEdges(image(window), edges, params.edgeStrength, params.excludedRegions, window.tl());
+    auto components = labelEdgeComponents(edges);
+    std::optional<size_t> best;
+    for(size_t i = 0; i < components.size(); i++) {
+        const auto& rect = components.rects[i];
+        if(isValidComponent(rect + window.tl(), params.imageROI)
+            && (!best || rect.area() > components.rects[*best].area())) {
+            best = i;
+        }
+    }
+    if(!best) {
+        return std::nullopt;
+    }
+    return fitFunction(image(window), window.tl())(components[*best]);
+}
+
+template<typename Callable>
+static inline auto detectGridPyramid(const cv::Mat& image,
+                                     const cv::Rect& searchRect,
+                                     const GridSearchParams& params,
+                                     CandidateSelection selection,
+                                     Callable fitFunction) {
+    using Result = decltype(fitFunction(cv::Mat{}, cv::Point{})(EdgeComponent{}));
+    cv::Mat coarse = image(searchRect);
+    {
+        CAMCALIB_TRACE_SCOPE("pyrDown");
+        for(int level = 0; level < params.pyramidLevels; level++) {
+            cv::Mat next;
+            cv::pyrDown(coarse, next);
+            coarse = next;
+        }
+    }
+    const auto scale = 1 << params.pyramidLevels;
+    const auto invScale = 1.0 / scale;
+    // Параметры грубого уровня в его собственных координатах
+    auto coarseParams = params;
+    if(params.imageROI) {
+        coarseParams.imageROI = scaleRect(*params.imageROI - searchRect.tl(), invScale, true);
+    }
+    for(auto& region: coarseParams.excludedRegions) {
+        region = scaleRect(region - searchRect.tl(), invScale, false);
+    }
+    cv::Mat coarseEdges;
+    {
+        CAMCALIB_TRACE_SCOPE("Canny");
+        findEdges(coarse, coarseEdges, params.edgeStrength, coarseParams.excludedRegions, cv::Point{});
+    }
+    if(!reportStage(params.progress, CalibrationStage::Components)) {
+        return std::vector<Result>{};
+    }
+    auto coarseComponents = labelEdgeComponents(coarseEdges);
+    CAMCALIB_TRACE_COUNTER("edgeComponents", coarseComponents.size());
+    auto coarseCandidates = findCandidateComponents(coarseComponents, coarseParams, cv::Point{}, selection);
+    CAMCALIB_TRACE_COUNTER("candidates", coarseCandidates.size());
+    if(!reportStage(params.progress, CalibrationStage::Fit)) {
+        return std::vector<Result>{};
+    }
+    // Окно полного разрешения вокруг каждой найденной метки с запасом на один пиксел грубого уровня
+    const auto margin = scale + SearchHalo;
+    std::vector<std::optional<Result>> fits(coarseCandidates.size());
+    std::transform(std::execution::par,
+                   coarseCandidates.begin(),
+                   coarseCandidates.end(),
+                   fits.begin(),
+                   [&](const EdgeComponent& candidate) {
+                       const auto& rect = candidate.rect;
+                       auto window = cv::Rect(rect.x * scale - margin,
+                                              rect.y * scale - margin,
+                                              rect.width * scale + 2 * margin,
+                                              rect.height * scale + 2 * margin);
+                       window = (window + searchRect.tl()) & searchRect;
+                       return fitInWindow(image, window, params, fitFunction);
+                   });
+    std::vector<Result> centers;
+    for(const auto& fit: fits) {
+        if(fit) {
+            centers.push_back(*fit);
+        }
+    }
+    return centers;
+}
+
+// Центры меток в порядке компонент, без упорядочивания по сетке
+template<typename Callable>
+static inline auto detectGrid(const cv::Mat& image,
+                              const GridSearchParams& params,
+                              CandidateSelection selection,
+                              Callable fitFunction) {
     assert(image.type() == CV_8U);
     assert(params.edgeStrength >= 0.0);
+    assert(params.pyramidLevels >= 0);
+    using Result = decltype(fitFunction(cv::Mat{}, cv::Point{})(EdgeComponent{}));
+    // Края и компоненты ищутся только внутри области поиска
+    auto searchRect = makeSearchRect(image.size(), params.imageROI);
+    if(searchRect.empty() || !reportStage(params.progress, CalibrationStage::Edges)) {
+        return std::vector<Result>{};
+    }
+    if(params.mode == GridSearchMode::Pyramid && params.pyramidLevels > 0) {
+        return detectGridPyramid(image, searchRect, params, selection, fitFunction);
+    }
+    cv::Mat edges;
+    {
+        CAMCALIB_TRACE_SCOPE("Canny");
+        findEdges(image(searchRect), edges, params.edgeStrength, params.excludedRegions, searchRect.tl());
+    }
+    if(!reportStage(params.progress, CalibrationStage::Components)) {
+        return std::vector<Result>{};
+    }
+    // Точки краев собираются при разметке, карта краев дальше не нужна
+    auto components = labelEdgeComponents(edges);
+    edges.release();
+    CAMCALIB_TRACE_COUNTER("edgeComponents", components.size());
+    auto candidates = findCandidateComponents(components, params, searchRect.tl(), selection);
+    CAMCALIB_TRACE_COUNTER("candidates", candidates.size());
+    if(!reportStage(params.progress, CalibrationStage::Fit)) {
+        return std::vector<Result>{};
+    }
+    CAMCALIB_TRACE_SCOPE("fit");
+    return fitCandidates(fitFunction(image(searchRect), searchRect.tl()), candidates);
+}
+
+// Кандидаты - все компоненты, прошедшие проверку формы и ROI
+static std::vector<cv::Rect> validComponentRects(const EdgeComponents& components,
+                                                 const GridSearchParams& params,
+                                                 const cv::Point& offset) {
+    std::vector<cv::Rect> result;
+    for(const auto& rect: components.rects) {
+        if(isValidComponent(rect + offset, params.imageROI)) {
+            result.push_back(rect + offset);
+        }
+    }
+    return result;
+}
+
+// Неудачная подгонка возвращает нулевой радиус
+static DetectionPreview removeFailedFits(DetectionPreview preview) {
+    auto& circles = preview.circles;
+    circles.erase(std::remove_if(circles.begin(), circles.end(), [](const cv::Vec3f& circle){
+        return circle[2] <= 0.0f;
+    }), circles.end());
+    return preview;
+}
+
+template<typename Callable>
+static DetectionPreview detectPreview(const cv::Mat& image, const GridSearchParams& params, Callable fitFunction) {
+    assert(image.type() == CV_8U);
+    auto searchRect = makeSearchRect(image.size(), params.imageROI);
+    if(searchRect.empty() || !reportStage(params.progress, CalibrationStage::Edges)) {
+        return {};
+    }
+    cv::Mat edges;
+    {
+        CAMCALIB_TRACE_SCOPE("Canny");
+        findEdges(image(searchRect), edges, params.edgeStrength, params.excludedRegions, searchRect.tl());
+    }
+    if(!reportStage(params.progress, CalibrationStage::Components)) {
+        return {};
+    }
+    auto components = labelEdgeComponents(edges);
+    edges.release();
+    auto result = DetectionPreview{};
+    result.candidates = validComponentRects(components, params, searchRect.tl());
+    auto selected = findCandidateComponents(components, params, searchRect.tl(),
+                                            CandidateSelection::LargestOrMedianArea);
+    if(!reportStage(params.progress, CalibrationStage::Fit)) {
+        return {};
+    }
+    result.circles = fitCandidates(fitFunction(image(searchRect), searchRect.tl()), selected);
+    return removeFailedFits(std::move(result));
+}
+
+static std::vector<cv::Vec3f> fitComponents(const cv::Mat& image,
+                                            const cv::Point& offset,
+                                            const GridSearchParams& params,
+                                            const std::vector<EdgeComponent>& components) {
+    switch(params.fitMethod) {
+    case CircleFitMethod::GradientWeighted:
+        return fitCandidates(makeGradientCircleSearcher(params)(image, offset), components);
+    case CircleFitMethod::Geometric:
+        return fitCandidates(makeGeometricCircleSearcher(image, offset), components);
+    case CircleFitMethod::Ellipse:
+        break;
+    }
+    return fitCandidates(makeCircleSearcher(image, offset), components);
+}
+
+static bool hasCache(const cv::Mat& image, const GridSearchParams& params) {
+    return params.cache && params.cache->isSourceOf(image);
+}
+
+// Поиск на полном разрешении с промежуточными результатами из params.cache.
+// Разметка и подгонка выполняются по той же области поиска, что и без кэша,
+// 16-битные изображения переводятся в 8 бит так же, как без кэша (convertTo8Bit).
+static DetectionPreview detectCached(const cv::Mat& image,
+                                     const GridSearchParams& params,
+                                     CandidateSelection selection) {
+    CAMCALIB_TRACE_SCOPE("detectCached");
+    auto& cache = *params.cache;
+    auto searchRect = makeSearchRect(image.size(), params.imageROI);
+    if(searchRect.empty() || !reportStage(params.progress, CalibrationStage::Edges)) {
+        return {};
+    }
+    auto cached = cache.findComponents(searchRect, params.edgeStrength, params.excludedRegions,
+                                       params.intensityRange);
+    CAMCALIB_TRACE_COUNTER("componentsCacheHit", cached ? 1 : 0);
+    if(!cached) {
+        auto entry = std::make_shared<CachedComponents>();
+        entry->searchRect = searchRect;
+        entry->edgeStrength = params.edgeStrength;
+        entry->excludedRegions = params.excludedRegions;
+        entry->intensityRange = params.intensityRange;
+        if(image.depth() != CV_8U) {
+            entry->searchImage = convertTo8Bit(image, searchRect, params);
+        } else {
+            entry->searchImage = image(searchRect);
+        }
+        cv::Mat edges;
+        {
+            CAMCALIB_TRACE_SCOPE("Canny");
+            findEdges(entry->searchImage, edges, params.edgeStrength, params.excludedRegions, searchRect.tl());
+        }
+        if(!reportStage(params.progress, CalibrationStage::Components)) {
+            return {};
+        }
+        entry->components = labelEdgeComponents(edges);
+        CAMCALIB_TRACE_COUNTER("edgeComponents", entry->components.size());
+        cache.insertComponents(entry);
+        cached = std::move(entry);
+    } else if(!reportStage(params.progress, CalibrationStage::Components)) {
+        return {};
+    }
+    const auto& components = cached->components;
+    const auto offset = cached->searchRect.tl();
+    auto result = DetectionPreview{};
+    result.candidates = validComponentRects(components, params, offset);
+    auto candidates = selectCandidates(components, params, offset, selection);
+    CAMCALIB_TRACE_COUNTER("candidates", candidates.size());
+    if(!reportStage(params.progress, CalibrationStage::Fit)) {
+        return {};
+    }
+    auto fits = cache.findFits(cached.get(), params.fitMethod);
+    std::vector<size_t> missing;
+    for(auto i: candidates) {
+        if(!fits || !fits->fitted[i]) {
+            missing.push_back(i);
+        }
+    }
+    if(!missing.empty()) {
+        CAMCALIB_TRACE_SCOPE("fit");
+        std::vector<EdgeComponent> missingComponents;
+        for(auto i: missing) {
+            missingComponents.push_back(components[i]);
+        }
+        auto circles = fitComponents(cached->searchImage, offset, params, missingComponents);
+        auto updated = fits ? std::make_shared<ComponentFits>(*fits) : std::make_shared<ComponentFits>();
+        updated->circles.resize(components.size());
+        updated->fitted.resize(components.size());
+        for(size_t k = 0; k < missing.size(); k++) {
+            updated->circles[missing[k]] = circles[k];
+            updated->fitted[missing[k]] = true;
+        }
+        cache.insertFits(cached.get(), params.fitMethod, updated);
+        fits = std::move(updated);
+    }
+    for(auto i: candidates) {
+        result.circles.push_back(fits->circles[i]);
+    }
+    return result;
+}
+
+struct Tile {
+    cv::Rect rect;
+    // Метки с центром в ядре принадлежат плитке, ядра плиток не пересекаются
+    cv::Rect core;
+};
+
+static std::vector<Tile> makeTiles(const cv::Rect& area, const cv::Size& tileSize, int overlap) {
+    auto coreSize = cv::Size(tileSize.width - overlap, tileSize.height - overlap);
+    std::vector<Tile> tiles;
+    for(int y = area.y; y < area.br().y; y += coreSize.height) {
+        for(int x = area.x; x < area.br().x; x += coreSize.width) {
+            auto core = cv::Rect(cv::Point(x, y), coreSize) & area;
+            auto rect = cv::Rect(core.x - overlap / 2,
+                                 core.y - overlap / 2,
+                                 core.width + overlap,
+                                 core.height + overlap);
+            tiles.push_back({rect & area, core});
+        }
+    }
+    return tiles;
+}
+
+static inline cv::Point2f centerOf(const cv::Point2f& center) {
+    return center;
+}
+
+static inline cv::Point2f centerOf(const cv::Vec3f& circle) {
+    return {circle[0], circle[1]};
+}
+
+// Метки плитки вместе с площадью рамки компоненты для общего отбора наибольших
+template<typename Callable>
+static auto detectTile(const cv::Mat& image,
+                       const cv::Rect& searchRect,
+                       const Tile& tile,
+                       const GridSearchParams& params,
+                       CandidateSelection selection,
+                       Callable fitFunction) {
+    using Result = decltype(fitFunction(cv::Mat{}, cv::Point{})(EdgeComponent{}));
+    CAMCALIB_TRACE_SCOPE("detectTile");
+    std::vector<std::pair<int, Result>> result;
+    // Этапы плиток не различаются, вызов нужен для отмены между плитками
+    if(!reportStage(params.progress, CalibrationStage::Edges) || isExcluded(tile.rect, params.excludedRegions)) {
+        return result;
+    }
+    cv::Mat tileImage = image(tile.rect);
+    if(tileImage.depth() == CV_16U) {
+        tileImage = convertTo8Bit(image, tile.rect, params);
+    }
+    // Компоненты, обрезанные внутренней границей плитки, отбрасываются: метка с центром
+    // в ядре целиком лежит в плитке, если перекрытие больше ее диаметра
+    auto tl = tile.rect.tl();
+    auto br = tile.rect.br();
+    tl.x += tl.x > searchRect.x ? 1 : 0;
+    tl.y += tl.y > searchRect.y ? 1 : 0;
+    br.x -= br.x < searchRect.br().x ? 1 : 0;
+    br.y -= br.y < searchRect.br().y ? 1 : 0;
+    auto inner = cv::Rect(tl, br);
+    auto roi = params.imageROI ? (*params.imageROI & inner) : inner;
     cv::Mat edges;
-    cv::Canny(image, edges, 0, params.edgeStrength);
-    auto rectangles = findCandidateRectangles(edges, params);
-    auto fit = fitFunction(std::move(edges));
-    std::vector<decltype(fit({}))> centers(rectangles.size());
+    findEdges(tileImage, edges, params.edgeStrength, params.excludedRegions, tile.rect.tl());
+    auto components = labelEdgeComponents(edges);
+    edges.release();
+    std::vector<EdgeComponent> candidates;
+    for(size_t i = 0; i < components.size(); i++) {
+        if(isValidComponent(components.rects[i] + tile.rect.tl(), roi)) {
+            candidates.push_back(components[i]);
+        }
+    }
+    // В сетку попадут не более gridSize.area() наибольших компонент плитки,
+    // отбор по медианной площади выполняется по всем плиткам вместе
+    if(selection == CandidateSelection::Largest) {
+        auto limit = std::min<size_t>(candidates.size(), params.gridSize.area());
+        std::partial_sort(candidates.begin(), candidates.begin() + limit, candidates.end(),
+                          [](const auto& c1, const auto& c2){
+                              return c1.rect.area() > c2.rect.area();
+                          });
+        candidates.resize(limit);
+    }
+    auto values = fitCandidates(fitFunction(tileImage, tile.rect.tl()), candidates);
+    for(size_t i = 0; i < candidates.size(); i++) {
+        auto center = centerOf(values[i]);
+        if(center.x >= tile.core.x && center.x < tile.core.br().x
+            && center.y >= tile.core.y && center.y < tile.core.br().y) {
+            result.emplace_back(candidates[i].rect.area(), values[i]);
+        }
+    }
+    return result;
+}
+
+// selection - Largest или MedianArea
+template<typename Callable>
+static inline auto detectGridTiled(const cv::Mat& image,
+                                   const GridSearchParams& params,
+                                   CandidateSelection selection,
+                                   Callable fitFunction) {
+    using Result = decltype(fitFunction(cv::Mat{}, cv::Point{})(EdgeComponent{}));
+    assert(params.tileOverlap >= 0);
+    assert(params.tileSize.width > params.tileOverlap && params.tileSize.height > params.tileOverlap);
+    auto searchRect = makeSearchRect(image.size(), params.imageROI);
+    auto tiles = makeTiles(searchRect, params.tileSize, params.tileOverlap);
+    // Диапазон яркости 16-битного изображения находится одним проходом до разбиения на плитки
+    auto tileParams = withIntensityRange(image, params);
+    // Одновременно в памяти находятся только плитки, обрабатываемые потоками
+    std::vector<std::vector<std::pair<int, Result>>> tileResults(tiles.size());
     std::transform(std::execution::par,
-                   rectangles.begin(),
-                   rectangles.end(),
-                   centers.begin(),
-                   fit);
+                   tiles.begin(),
+                   tiles.end(),
+                   tileResults.begin(),
+                   [&](const Tile& tile) {
+                       return detectTile(image, searchRect, tile, tileParams, selection, fitFunction);
+                   });
+    // Проверка отмены: часть плиток отмененного поиска пуста
+    if(!reportStage(params.progress, CalibrationStage::Fit)) {
+        return std::vector<Result>{};
+    }
+    std::vector<std::pair<int, Result>> merged;
+    for(auto& tileResult: tileResults) {
+        merged.insert(merged.end(), tileResult.begin(), tileResult.end());
+    }
+    if(selection == CandidateSelection::MedianArea) {
+        std::vector<Result> centers;
+        if(merged.empty()) {
+            return centers;
+        }
+        std::vector<int> areas(merged.size());
+        std::transform(merged.begin(), merged.end(), areas.begin(), [](const auto& r){
+            return r.first;
+        });
+        auto median = areas.begin() + areas.size() / 2;
+        std::nth_element(areas.begin(), median, areas.end());
+        for(const auto& r: merged) {
+            if(r.first >= *median / 4 && r.first <= *median * 4) {
+                centers.push_back(r.second);
+            }
+        }
+        return centers;
+    }
+    const auto count = static_cast<size_t>(params.gridSize.area());
+    if(merged.size() < count) {
+        std::cerr << __FUNCTION__" count of components too small" << std::endl;
+        return std::vector<Result>{};
+    }
+    std::partial_sort(merged.begin(), merged.begin() + count, merged.end(), [](const auto& r1, const auto& r2){
+        return r1.first > r2.first;
+    });
+    std::vector<Result> centers(count);
+    std::transform(merged.begin(), merged.begin() + count, centers.begin(), [](const auto& r){
+        return r.second;
+    });
+    return centers;
+}
+
+template<typename Callable>
+static inline auto findGrid(const cv::Mat& image, const GridSearchParams& params, Callable fitFunction) {
+    assert(!params.gridSize.empty());
+    auto centers = params.mode == GridSearchMode::Tiled
+        ? detectGridTiled(image, params, CandidateSelection::Largest, fitFunction)
+        : detectGrid(image, params, CandidateSelection::Largest, fitFunction);
+    // Пустой результат после отмены не считается ошибкой упорядочивания
+    if(centers.empty()) {
+        return centers;
+    }
     return sortGrid(std::move(centers), params.gridSize);
 }
 
+static GridSearchParams moveSearchParams(GridSearchParams params, const cv::Point& offset) {
+    if(params.imageROI) {
+        *params.imageROI -= offset;
+    }
+    for(auto& region: params.excludedRegions) {
+        region -= offset;
+    }
+    return params;
+}
+
+static void moveResult(std::vector<cv::Point2f>& points, const cv::Point& offset) {
+    for(auto& p: points) {
+        p += cv::Point2f(offset);
+    }
+}
+
+static void moveResult(std::vector<cv::Vec3f>& circles, const cv::Point& offset) {
+    for(auto& c: circles) {
+        c[0] += offset.x;
+        c[1] += offset.y;
+    }
+}
+
+static void moveResult(IndexedGrid& grid, const cv::Point& offset) {
+    moveResult(grid.centers, offset);
+}
+
+static void moveResult(std::optional<cv::Vec3f>& circle, const cv::Point& offset) {
+    if(circle) {
+        (*circle)[0] += offset.x;
+        (*circle)[1] += offset.y;
+    }
+}
+
+static void moveResult(DetectionPreview& preview, const cv::Point& offset) {
+    for(auto& rect: preview.candidates) {
+        rect += offset;
+    }
+    moveResult(preview.circles, offset);
+}
+
+// 16-битные кадры (в т.ч. отображенные в память) переводятся в 8 бит только в пределах
+// области rect (convertTo8Bit), остальные страницы изображения читаются только при поиске
+// диапазона яркости, если он не задан
+template<typename Detector>
+static auto detectConverted(const cv::Mat& image, const cv::Rect& rect,
+                            const GridSearchParams& params, Detector detect) {
+    cv::Mat converted;
+    if(!rect.empty()) {
+        converted = convertTo8Bit(image, rect, params);
+    }
+    auto result = detect(converted, moveSearchParams(params, rect.tl()));
+    moveResult(result, rect.tl());
+    return result;
+}
+
 std::vector<cv::Point2f> findCirclesCentersGrid(const cv::Mat& image, const GridSearchParams& params) {
-    return findGrid(image, params, makeCircleCenterSearcher);
+    CAMCALIB_TRACE_SCOPE("findCirclesCentersGrid");
+    if(hasCache(image, params) && params.mode == GridSearchMode::FullResolution) {
+        return toCenters(findCirclesGrid(image, params));
+    }
+    // Плитки 16-битного изображения переводятся в 8 бит по отдельности с общим диапазоном
+    if(image.depth() == CV_16U && params.mode != GridSearchMode::Tiled) {
+        return detectConverted(image, makeSearchRect(image.size(), params.imageROI), params,
+                               findCirclesCentersGrid);
+    }
+    switch(params.fitMethod) {
+    case CircleFitMethod::GradientWeighted:
+        return findGrid(image, params, makeCenterSearcher(makeGradientCircleSearcher(params)));
+    case CircleFitMethod::Geometric:
+        return findGrid(image, params, makeCenterSearcher(makeGeometricCircleSearcher));
+    case CircleFitMethod::Ellipse:
+        break;
+    }
+    return findGrid(image, params, makeCenterSearcher(makeCircleSearcher));
 }
 
 std::vector<cv::Vec3f> findCirclesGrid(const cv::Mat &image, const GridSearchParams &params) {
+    CAMCALIB_TRACE_SCOPE("findCirclesGrid");
+    if(hasCache(image, params) && params.mode == GridSearchMode::FullResolution) {
+        auto circles = detectCached(image, params, CandidateSelection::Largest).circles;
+        if(circles.empty()) {
+            return circles;
+        }
+        return sortGrid(std::move(circles), params.gridSize);
+    }
+    if(image.depth() == CV_16U && params.mode != GridSearchMode::Tiled) {
+        return detectConverted(image, makeSearchRect(image.size(), params.imageROI), params,
+                               findCirclesGrid);
+    }
+    switch(params.fitMethod) {
+    case CircleFitMethod::GradientWeighted:
+        return findGrid(image, params, makeGradientCircleSearcher(params));
+    case CircleFitMethod::Geometric:
+        return findGrid(image, params, makeGeometricCircleSearcher);
+    case CircleFitMethod::Ellipse:
+        break;
+    }
     return findGrid(image, params, makeCircleSearcher);
 }
 
+std::optional<cv::Vec3f> findCircleInWindow(const cv::Mat &image,
+                                            const cv::Rect &window,
+                                            const GridSearchParams &params) {
+    auto clipped = window & cv::Rect(cv::Point{}, image.size());
+    if(clipped.empty()) {
+        return std::nullopt;
+    }
+    if(image.depth() == CV_16U) {
+        auto localWindow = cv::Rect(cv::Point{}, clipped.size());
+        return detectConverted(image, clipped, params, [localWindow](const cv::Mat& converted,
+                                                                    const GridSearchParams& localParams) {
+            return findCircleInWindow(converted, localWindow, localParams);
+        });
+    }
+    assert(image.type() == CV_8U);
+    switch(params.fitMethod) {
+    case CircleFitMethod::GradientWeighted:
+        return fitInWindow(image, clipped, params, makeGradientCircleSearcher(params));
+    case CircleFitMethod::Geometric:
+        return fitInWindow(image, clipped, params, makeGeometricCircleSearcher);
+    case CircleFitMethod::Ellipse:
+        break;
+    }
+    return fitInWindow(image, clipped, params, makeCircleSearcher);
+}
+
+DetectionPreview previewCirclesGrid(const cv::Mat &image, const GridSearchParams &params) {
+    CAMCALIB_TRACE_SCOPE("previewCirclesGrid");
+    if(hasCache(image, params)) {
+        return removeFailedFits(detectCached(image, params, CandidateSelection::LargestOrMedianArea));
+    }
+    if(image.depth() == CV_16U) {
+        return detectConverted(image, makeSearchRect(image.size(), params.imageROI), params,
+                               previewCirclesGrid);
+    }
+    switch(params.fitMethod) {
+    case CircleFitMethod::GradientWeighted:
+        return detectPreview(image, params, makeGradientCircleSearcher(params));
+    case CircleFitMethod::Geometric:
+        return detectPreview(image, params, makeGeometricCircleSearcher);
+    case CircleFitMethod::Ellipse:
+        break;
+    }
+    return detectPreview(image, params, makeCircleSearcher);
+}
+
+IndexedGrid findCirclesCentersIndexedGrid(const cv::Mat &image, const GridSearchParams &params) {
+    CAMCALIB_TRACE_SCOPE("findCirclesCentersIndexedGrid");
+    if(hasCache(image, params) && params.mode == GridSearchMode::FullResolution) {
+        return indexGrid(toCenters(detectCached(image, params, CandidateSelection::MedianArea).circles));
+    }
+    // Плитки 16-битного изображения переводятся в 8 бит по отдельности с общим диапазоном
+    if(image.depth() == CV_16U && params.mode != GridSearchMode::Tiled) {
+        return detectConverted(image, makeSearchRect(image.size(), params.imageROI), params,
+                               findCirclesCentersIndexedGrid);
+    }
+    auto detect = [&image, &params](auto fitFunction) {
+        return params.mode == GridSearchMode::Tiled
+            ? detectGridTiled(image, params, CandidateSelection::MedianArea, fitFunction)
+            : detectGrid(image, params, CandidateSelection::MedianArea, fitFunction);
+    };
+    std::vector<cv::Point2f> centers;
+    switch(params.fitMethod) {
+    case CircleFitMethod::GradientWeighted:
+        centers = detect(makeCenterSearcher(makeGradientCircleSearcher(params)));
+        break;
+    case CircleFitMethod::Geometric:
+        centers = detect(makeCenterSearcher(makeGeometricCircleSearcher));
+        break;
+    case CircleFitMethod::Ellipse:
+        centers = detect(makeCenterSearcher(makeCircleSearcher));
+        break;
+    }
+    return indexGrid(centers);
+}
+
+std::vector<cv::Point2f> generatePointsGrid(const std::vector<cv::Point> &indices, double patternStep) {
+    std::vector<cv::Point2f> grid(indices.size());
+    std::transform(indices.begin(), indices.end(), grid.begin(), [patternStep](const cv::Point& index){
+        return cv::Point2f(index.x * static_cast<float>(patternStep),
+                           index.y * static_cast<float>(patternStep));
+    });
+    return grid;
+}
+
 std::vector<cv::Point2f> generatePointsGrid(const cv::Size &patternSize,
                                             double patternStep) {
     if(patternSize.empty()) {
@@ -228,25 +1027,13 @@ std::vector<cv::Point2f> generatePointsGrid(const cv::Size &patternSize,
 
 std::optional<cv::Matx33f> calibrate(std::vector<cv::Point2f> centersImage,
                                      std::vector<cv::Point2f> centersWorld) {
-    if(centersImage.size() != centersWorld.size()) {
+    CAMCALIB_TRACE_SCOPE("calibrate");
+    PixelSizeEstimator estimator;
+    if(!estimator.addFrame(centersImage, centersWorld)) {
+        std::cerr << __FUNCTION__": can't find least squares projection matrix" << std::endl;
         return std::nullopt;
     }
-    auto normMatrixWorld = makeNormalizationMatrix(centersWorld);
-    cv::transform(centersWorld,
-                  centersWorld,
-                  normMatrixWorld);
-    auto normMatrixImage = makeNormalizationMatrix(centersImage);
-    cv::transform(centersImage,
-                  centersImage,
-                  normMatrixImage);
-    auto projectionMatrix = makeProjectionMatrix(centersImage, centersWorld);
-    if(projectionMatrix) {
-        auto proj = toMatx33f(normMatrixImage).inv() * toMatx33f(*projectionMatrix) * toMatx33f(normMatrixWorld);
-        auto [f, r] = factorizeCameraMatrix(proj);
-        std::cout << f(0, 0) << " " << f(1, 1) << std::endl;
-        return f;
-    }
-    return std::nullopt;
+    return cv::Matx33f(*estimator.cameraMatrix());
 }
 
 void drawGrid(const std::vector<cv::Point2f> &grid, cv::Mat dst, const cv::Scalar &color) {
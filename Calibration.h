@@ -1,26 +1,122 @@
 #pragma once
 
+#include "GridIndexing.h"
+#include "Progress.h"
 #include <opencv2/core.hpp>
+#include <memory>
 #include <optional>
 
 namespace camcalib {
 
+class DetectionCache;
+
+enum class StackingMode {
+    // Среднее по всем кадрам
+    Mean,
+    // Среднее по значениям, отличающимся от среднего не более чем на clipSigma СКО
+    SigmaClipped
+};
+
+struct StackingParams {
+    StackingMode mode{StackingMode::Mean};
+    double clipSigma{3.0};
+    int readerThreads{2};
+    // Максимальное число декодированных кадров, ожидающих накопления
+    size_t queueSize{1};
+};
+
+// Кадры 8 и 16 бит одного размера, результат в разрядности первого кадра
 cv::Mat accumulateImageFromFiles(const std::vector<std::string>& files);
+cv::Mat accumulateImageFromFiles(const std::vector<std::string>& files, const StackingParams& params);
 
 std::vector<cv::Point2f> generatePointsGrid(const cv::Size& patternSize, double patternStep);
+// Мировые координаты узлов с индексами (столбец, строка)
+std::vector<cv::Point2f> generatePointsGrid(const std::vector<cv::Point>& indices, double patternStep);
+
+enum class GridSearchMode {
+    // Поиск краев и компонент на полном разрешении
+    FullResolution,
+    // Поиск меток на уровне pyramidLevels пирамиды и уточнение в окнах полного разрешения.
+    // Центры совпадают с FullResolution в пределах 0.05 пикс, если диаметр метки
+    // на грубом уровне не меньше 8 пикс (проверяется measurePyramid в Benchmark.cpp).
+    Pyramid,
+    // Обработка перекрывающихся плиток tileSize параллельно, для изображений, которые
+    // не помещаются в память целиком (например, отображенных в память мозаик).
+    // Перекрытие должно быть не меньше диаметра метки плюс 4 пикс.
+    // Яркость 16-битных плиток переводится в 8 бит общим диапазоном (intensityRange).
+    // Применяется к findCirclesCentersGrid, findCirclesGrid и findCirclesCentersIndexedGrid
+    // (отбор по медианной площади выполняется по меткам всех плиток).
+    Tiled
+};
+
+enum class CircleFitMethod {
+    // Эллипс по точкам краев Кэнни
+    Ellipse,
+    // Оценка по градиенту полутонового изображения (fitCircleGradient)
+    GradientWeighted,
+    // Окружность по точкам краев: Таубин и Гаусс-Ньютон, все метки одним пакетом (fitCircles)
+    Geometric
+};
 
 struct GridSearchParams {
     double edgeStrength{100.0};
     cv::Size gridSize;
     std::optional<cv::Rect> imageROI{std::nullopt};
+    // Области, в которых метки не ищутся: их яркость заменяется постоянной до поиска краев,
+    // плитки и окна, целиком лежащие в одной области, пропускаются
+    std::vector<cv::Rect> excludedRegions{};
+    GridSearchMode mode{GridSearchMode::FullResolution};
+    int pyramidLevels{2};
+    cv::Size tileSize{4096, 4096};
+    int tileOverlap{256};
+    CircleFitMethod fitMethod{CircleFitMethod::Ellipse};
+    // Этапы поиска и отмена, может вызываться из нескольких потоков одновременно.
+    // Отмененный поиск возвращает пустой результат.
+    ProgressCallback progress{};
+    // Диапазон яркости 16-битного изображения (минимум, максимум), переводимый в 0..255
+    // для всей области поиска, всех плиток и окон. Пустой - находится по области поиска
+    // (withIntensityRange) при каждом вызове.
+    std::optional<cv::Vec2d> intensityRange{};
+    // 16-битное изображение с обратным порядком байтов (MappedFrame::swappedByteOrder),
+    // байты переставляются только в областях, переводимых в 8 бит
+    bool swappedByteOrder{false};
+    // Промежуточные результаты поиска на полном разрешении (DetectionCache.h),
+    // используются, если кэш создан для того же изображения
+    std::shared_ptr<DetectionCache> cache{};
 };
 
+// params с диапазоном яркости 16-битного изображения по области поиска, если он не задан.
+// Следует вызывать один раз на кадр перед серией findCircleInWindow.
+GridSearchParams withIntensityRange(const cv::Mat& image, GridSearchParams params);
+
 std::vector<cv::Point2f> findCirclesCentersGrid(const cv::Mat& image, const GridSearchParams& params);
 std::vector<cv::Vec3f> findCirclesGrid(const cv::Mat& image, const GridSearchParams& params);
+// Уточнение одной метки в окне: выбирается наибольшая компонента краев окна.
+// gridSize не используется, пустой результат - метка не найдена.
+// Без params.intensityRange 16-битное изображение просматривается по всей области поиска.
+std::optional<cv::Vec3f> findCircleInWindow(const cv::Mat& image,
+                                            const cv::Rect& window,
+                                            const GridSearchParams& params);
+// Промежуточный результат поиска для подбора параметров
+struct DetectionPreview {
+    // Компоненты краев, прошедшие проверку формы и ROI
+    std::vector<cv::Rect> candidates;
+    // Окружности меток, отобранных среди candidates
+    std::vector<cv::Vec3f> circles;
+};
+// Поиск на полном разрешении без упорядочивания по сетке. Отбираются gridSize.area()
+// наибольших компонент, а если gridSize пуст или компонент меньше - близкие к медианной площади.
+DetectionPreview previewCirclesGrid(const cv::Mat& image, const GridSearchParams& params);
+// Поиск неполной или повернутой сетки: gridSize не используется,
+// в результат входят только метки, пронумерованные indexGrid
+IndexedGrid findCirclesCentersIndexedGrid(const cv::Mat& image, const GridSearchParams& params);
 
 void drawGrid(const std::vector<cv::Point2f>& grid, cv::Mat dst, const cv::Scalar& color);
 
 std::optional<cv::Matx33f> calibrate(std::vector<cv::Point2f> centersImage,
                                      std::vector<cv::Point2f> centersWorld);
 
+// matrix = F * R: F - масштабы и скос (верхнетреугольная), R - поворот и сдвиг
+std::pair<cv::Matx33d, cv::Matx33d> factorizeCameraMatrix(const cv::Matx33d& matrix);
+
 }
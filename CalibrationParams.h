@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Calibration.h"
+#include "MappedImage.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+struct CalibrationParams {
+    double edgeStrength;
+    double gridStep;
+    cv::Size gridSize;
+    std::optional<cv::Rect> imageROI;
+    std::vector<cv::Rect> excludedRegions{};
+    // 0 - поиск на полном разрешении
+    int pyramidLevels{0};
+    // Сторона плитки для изображений больше памяти, 0 - без разбиения
+    int tileSize{0};
+    // Перекрытие плиток, не меньше диаметра метки плюс 4 пикс
+    int tileOverlap{256};
+    camcalib::CircleFitMethod fitMethod{camcalib::CircleFitMethod::Ellipse};
+    // Сетка может быть видна не полностью, узлы нумеруются по соседям (indexGrid)
+    bool partialGrid{false};
+};
+
+inline camcalib::GridSearchParams makeGridSearchParams(const CalibrationParams& params) {
+    auto result = camcalib::GridSearchParams{};
+    result.edgeStrength = params.edgeStrength;
+    result.gridSize = params.gridSize;
+    result.imageROI = params.imageROI;
+    result.excludedRegions = params.excludedRegions;
+    result.fitMethod = params.fitMethod;
+    if(params.tileSize > 0) {
+        result.mode = camcalib::GridSearchMode::Tiled;
+        result.tileSize = cv::Size{params.tileSize, params.tileSize};
+        result.tileOverlap = params.tileOverlap;
+    } else if(params.pyramidLevels > 0) {
+        result.mode = camcalib::GridSearchMode::Pyramid;
+        result.pyramidLevels = params.pyramidLevels;
+    }
+    return result;
+}
+
+// Наибольший диаметр метки, которую не теряет перекрытие плиток tileOverlap
+inline int maxTiledDotDiameter(int tileOverlap) {
+    return tileOverlap - 4;
+}
+
+// Плитка должна вмещать перекрытия с обеих сторон и метку в ядре
+inline int minTileSize(int tileOverlap) {
+    return 2 * tileOverlap + maxTiledDotDiameter(tileOverlap) + 1;
+}
+
+// Найденные центры и соответствующие им мировые координаты
+struct GridCorrespondences {
+    std::vector<cv::Point2f> centersImage;
+    std::vector<cv::Point2f> centersWorld;
+};
+
+// searchParams - makeGridSearchParams(params) с параметрами вызова
+inline GridCorrespondences findGridCorrespondences(const cv::Mat& image,
+                                                   const CalibrationParams& params,
+                                                   const camcalib::GridSearchParams& searchParams) {
+    if(params.partialGrid) {
+        auto grid = camcalib::findCirclesCentersIndexedGrid(image, searchParams);
+        // Аффинная модель определяется не менее чем тремя точками
+        if(grid.centers.size() < 3) {
+            return {};
+        }
+        auto world = camcalib::generatePointsGrid(grid.indices, params.gridStep);
+        return {std::move(grid.centers), std::move(world)};
+    }
+    auto centers = camcalib::findCirclesCentersGrid(image, searchParams);
+    if(centers.empty()) {
+        return {};
+    }
+    return {std::move(centers), camcalib::generatePointsGrid(params.gridSize, params.gridStep)};
+}
+
+inline GridCorrespondences detectGridCorrespondences(const cv::Mat& image,
+                                                     const CalibrationParams& params,
+                                                     camcalib::ProgressCallback progress = {},
+                                                     std::shared_ptr<camcalib::DetectionCache> cache = {}) {
+    auto searchParams = makeGridSearchParams(params);
+    searchParams.progress = std::move(progress);
+    searchParams.cache = std::move(cache);
+    return findGridCorrespondences(image, params, searchParams);
+}
+
+// Кадр отображенного файла: порядок байтов передается поиску меток явно
+inline GridCorrespondences detectGridCorrespondences(const camcalib::MappedFrame& frame,
+                                                     const CalibrationParams& params,
+                                                     camcalib::ProgressCallback progress = {}) {
+    auto searchParams = makeGridSearchParams(params);
+    searchParams.progress = std::move(progress);
+    searchParams.swappedByteOrder = frame.swappedByteOrder;
+    return findGridCorrespondences(frame.image, params, searchParams);
+}
@@ -22,35 +22,56 @@ void CameraModel::setOpticalCenter(const cv::Point2d &pos) {
     emit changed();
 }
 
-void CameraModel::saveToFile(const QString &filename) const {
-    cv::FileStorage storage(filename.toUtf8().toStdString(), cv::FileStorage::WRITE);
-    if(mOpticalCenter) {
-        storage << "optical_center" << *mOpticalCenter;
+void CameraModel::setDistortion(const camcalib::LensDistortion &distortion) {
+    assignDistortion(distortion);
+    emit changed();
+}
+
+std::optional<camcalib::LensDistortion> CameraModel::distortion() const {
+    std::lock_guard lock{mUndistortionMutex};
+    return mDistortion;
+}
+
+std::shared_ptr<const camcalib::UndistortionMap> CameraModel::undistortionMap(cv::Size imageSize) const {
+    std::lock_guard lock{mUndistortionMutex};
+    if(!mDistortion) {
+        return nullptr;
+    }
+    auto& map = mUndistortionMaps[{imageSize.width, imageSize.height}];
+    if(!map) {
+        map = std::make_shared<camcalib::UndistortionMap>(camcalib::makeUndistortionMap(*mDistortion, imageSize));
     }
-    storage << "magnifications" << "[";
-    for(const auto& magn: mMagnifications) {
-        storage << "{"
-                << "name" << magn.name
-                << "pixel_size" << magn.pixelSize
-                << "}";
+    return map;
+}
+
+void CameraModel::undistort(const cv::Mat &src, cv::Mat &dst) const {
+    if(auto map = undistortionMap(src.size())) {
+        camcalib::undistortImage(src, dst, *map);
+    } else {
+        src.copyTo(dst);
     }
-    storage << "]";
+}
+
+void CameraModel::assignDistortion(std::optional<camcalib::LensDistortion> distortion) {
+    std::lock_guard lock{mUndistortionMutex};
+    mDistortion = std::move(distortion);
+    mUndistortionMaps.clear();
+}
+
+void CameraModel::saveToFile(const QString &filename) const {
+    cv::FileStorage storage(filename.toUtf8().toStdString(), cv::FileStorage::WRITE);
+    camcalib::writeMeasurementModel(storage, {mOpticalCenter, distortion(), mMagnifications});
     storage.release();
 }
 
 void CameraModel::loadFromFile(const QString &filename) {
-    mMagnifications.clear();
     cv::FileStorage storage(filename.toUtf8().toStdString(), cv::FileStorage::READ);
-    if(auto node = storage["optical_center"]; !node.empty()) {
-        mOpticalCenter.emplace();
-        node >> *mOpticalCenter;
-    }
-    for(const auto& node: storage["magnifications"]) {
-        Magnification magn;
-        node["name"] >> magn.name;
-        node["pixel_size"] >> magn.pixelSize;
-        mMagnifications.emplace_back(std::move(magn));
+    auto model = camcalib::readMeasurementModel(storage);
+    if(model.opticalCenter) {
+        mOpticalCenter = model.opticalCenter;
     }
+    assignDistortion(std::move(model.distortion));
+    mMagnifications = std::move(model.magnifications);
     emit changed();
 }
 
@@ -59,6 +80,9 @@ void CameraModel::updateUi(QTreeWidget *ui) const {
     if(mOpticalCenter) {
         ui->addTopLevelItem(makeOpticalCenterItem());
     }
+    if(mDistortion) {
+        ui->addTopLevelItem(makeDistortionItem());
+    }
     if(!empty()) {
         auto items = QList<QTreeWidgetItem*>{};
         std::transform(mMagnifications.cbegin(),
@@ -98,3 +122,21 @@ QTreeWidgetItem *CameraModel::makeOpticalCenterItem() const {
     return item;
 }
 
+QTreeWidgetItem *CameraModel::makeDistortionItem() const {
+    auto item = new QTreeWidgetItem();
+    item->setText(0, tr("Дисторсия"));
+    makeItemForFloatingNumber(item, tr("Центр X"), mDistortion->center.x, 3);
+    makeItemForFloatingNumber(item, tr("Центр Y"), mDistortion->center.y, 3);
+    auto addCoefficient = [item](const QString& title, double value) {
+        auto child = new QTreeWidgetItem(item);
+        child->setText(0, title);
+        child->setText(1, QString::number(value, 'e', 6));
+    };
+    addCoefficient(tr("k1"), mDistortion->k1);
+    addCoefficient(tr("k2"), mDistortion->k2);
+    addCoefficient(tr("p1"), mDistortion->p1);
+    addCoefficient(tr("p2"), mDistortion->p2);
+    addCoefficient(tr("s1"), mDistortion->s1);
+    addCoefficient(tr("s2"), mDistortion->s2);
+    return item;
+}
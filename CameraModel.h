@@ -1,7 +1,14 @@
 #pragma once
 
+#include "Distortion.h"
+#include "MeasurementModel.h"
+#include "Undistortion.h"
 #include <QObject>
 #include <opencv2/core.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 
 class QTreeWidget;
 class QTreeWidgetItem;
@@ -13,6 +20,13 @@ public:
     void clear();
     void addMagnification(std::string name, const cv::Matx33d& cameraMatrix);
     void setOpticalCenter(const cv::Point2d& pos);
+    void setDistortion(const camcalib::LensDistortion& distortion);
+    std::optional<camcalib::LensDistortion> distortion() const;
+    // Таблица строится при первом обращении для размера кадра и хранится до изменения дисторсии.
+    // Без дисторсии - nullptr. Может вызываться из любого потока.
+    std::shared_ptr<const camcalib::UndistortionMap> undistortionMap(cv::Size imageSize) const;
+    // Без дисторсии кадр копируется без изменений
+    void undistort(const cv::Mat& src, cv::Mat& dst) const;
     void saveToFile(const QString& filename) const;
     void loadFromFile(const QString& filename);
     void updateUi(QTreeWidget* ui) const;
@@ -21,11 +35,14 @@ signals:
     void changed();
 private:
     std::optional<cv::Point2d> mOpticalCenter;
-    struct Magnification {
-        std::string name;
-        cv::Size2d pixelSize;        
-    };
+    std::optional<camcalib::LensDistortion> mDistortion;
+    // Таблицы исправления строятся по mDistortion, поэтому меняются вместе под блокировкой
+    void assignDistortion(std::optional<camcalib::LensDistortion> distortion);
+    mutable std::mutex mUndistortionMutex;
+    mutable std::map<std::pair<int, int>, std::shared_ptr<const camcalib::UndistortionMap>> mUndistortionMaps;
+    using Magnification = camcalib::Magnification;
     static QTreeWidgetItem* makeMagnificationItem(const Magnification& magnification);
     QTreeWidgetItem* makeOpticalCenterItem() const;
+    QTreeWidgetItem* makeDistortionItem() const;
     std::vector<Magnification> mMagnifications;
 };
@@ -1,6 +1,11 @@
 #include "CircleFit.h"
+#include "Trace.h"
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <ceres/ceres.h>
+#include <algorithm>
+#include <execution>
+#include <numeric>
 
 namespace {
 
@@ -27,11 +32,291 @@ auto findInitialGuess(const std::vector<cv::Point2f> &samples) {
     return cv::Vec3d{x, y, r};
 }
 
+struct GradientMoments {
+    // Нормальная система для центра: A = sum(n * n^T), b = sum(n * n^T * p), n = (-gy, gx)
+    double a11{}, a12{}, a22{}, b1{}, b2{};
+    // Моменты с весом |grad|^2 для радиуса
+    double w{}, wx{}, wy{}, wr{};
+};
+
+// Моменты точек относительно центра тяжести, z = x^2 + y^2
+struct CircleMoments {
+    double xx{}, yy{}, xy{}, xz{}, yz{}, zz{};
+};
+
+CircleMoments accumulateMoments(const float* x, const float* y, int n, float cx, float cy) {
+    CircleMoments m;
+    int i = 0;
+#if CV_SIMD128
+    auto zero = cv::v_setzero_f32();
+    auto xx = zero, yy = zero, xy = zero, xz = zero, yz = zero, zz = zero;
+    auto vcx = cv::v_setall_f32(cx);
+    auto vcy = cv::v_setall_f32(cy);
+    for(; i <= n - 4; i += 4) {
+        auto dx = cv::v_load(x + i) - vcx;
+        auto dy = cv::v_load(y + i) - vcy;
+        auto z = dx * dx + dy * dy;
+        xx = xx + dx * dx;
+        yy = yy + dy * dy;
+        xy = xy + dx * dy;
+        xz = xz + dx * z;
+        yz = yz + dy * z;
+        zz = zz + z * z;
+    }
+    m.xx = cv::v_reduce_sum(xx);
+    m.yy = cv::v_reduce_sum(yy);
+    m.xy = cv::v_reduce_sum(xy);
+    m.xz = cv::v_reduce_sum(xz);
+    m.yz = cv::v_reduce_sum(yz);
+    m.zz = cv::v_reduce_sum(zz);
+#endif
+    for(; i < n; i++) {
+        double dx = x[i] - cx;
+        double dy = y[i] - cy;
+        auto z = dx * dx + dy * dy;
+        m.xx += dx * dx;
+        m.yy += dy * dy;
+        m.xy += dx * dy;
+        m.xz += dx * z;
+        m.yz += dy * z;
+        m.zz += z * z;
+    }
+    return m;
+}
+
+// Алгебраическая оценка Таубина (реализация Чернова), центр относительно центра тяжести
+std::optional<cv::Vec3d> fitTaubin(const CircleMoments& sums, int n) {
+    auto mxx = sums.xx / n;
+    auto myy = sums.yy / n;
+    auto mxy = sums.xy / n;
+    auto mxz = sums.xz / n;
+    auto myz = sums.yz / n;
+    auto mzz = sums.zz / n;
+    auto mz = mxx + myy;
+    auto covXY = mxx * myy - mxy * mxy;
+    auto varZ = mzz - mz * mz;
+    auto a3 = 4.0 * mz;
+    auto a2 = -3.0 * mz * mz - mzz;
+    auto a1 = varZ * mz + 4.0 * covXY * mz - mxz * mxz - myz * myz;
+    auto a0 = mxz * (mxz * myy - myz * mxy) + myz * (myz * mxx - mxz * mxy) - varZ * covXY;
+    // Наименьший корень характеристического многочлена методом Ньютона от нуля
+    auto root = 0.0;
+    auto value = a0;
+    for(int iteration = 0; iteration < 20; iteration++) {
+        auto derivative = a1 + root * (2.0 * a2 + 3.0 * a3 * root);
+        auto next = root - value / derivative;
+        if(next == root || !std::isfinite(next)) {
+            break;
+        }
+        auto nextValue = a0 + next * (a1 + next * (a2 + next * a3));
+        if(std::abs(nextValue) >= std::abs(value)) {
+            break;
+        }
+        root = next;
+        value = nextValue;
+    }
+    auto det = root * root - root * mz + covXY;
+    if(std::abs(det) < 1e-12 * mz * mz) {
+        return std::nullopt;
+    }
+    auto cx = (mxz * (myy - root) - myz * mxy) / det / 2.0;
+    auto cy = (myz * (mxx - root) - mxz * mxy) / det / 2.0;
+    return cv::Vec3d{cx, cy, std::sqrt(cx * cx + cy * cy + mz)};
+}
+
+// Нормальная система шага Гаусса-Ньютона для невязок d_i - R, J_i = (-ux, -uy, -1)
+struct NormalEquations {
+    double uxx{}, uxy{}, uyy{}, ux{}, uy{}, count{};
+    double uxr{}, uyr{}, r{};
+};
+
+// Центр (cx, cy) задан относительно origin
+NormalEquations accumulateNormalEquations(const float* x, const float* y, int n,
+                                          const cv::Point2f& origin,
+                                          float cx, float cy, float radius) {
+    NormalEquations e;
+    int i = 0;
+#if CV_SIMD128
+    auto zero = cv::v_setzero_f32();
+    auto uxx = zero, uxy = zero, uyy = zero, ux = zero, uy = zero, count = zero;
+    auto uxr = zero, uyr = zero, r = zero;
+    auto vox = cv::v_setall_f32(origin.x);
+    auto voy = cv::v_setall_f32(origin.y);
+    auto vcx = cv::v_setall_f32(cx);
+    auto vcy = cv::v_setall_f32(cy);
+    auto vr = cv::v_setall_f32(radius);
+    auto one = cv::v_setall_f32(1.0f);
+    for(; i <= n - 4; i += 4) {
+        auto dx = (cv::v_load(x + i) - vox) - vcx;
+        auto dy = (cv::v_load(y + i) - voy) - vcy;
+        auto d = cv::v_sqrt(dx * dx + dy * dy);
+        // Точка в центре окружности не задает направления и пропускается
+        auto valid = d > zero;
+        auto invD = cv::v_select(valid, one / cv::v_select(valid, d, one), zero);
+        auto vux = dx * invD;
+        auto vuy = dy * invD;
+        auto residual = cv::v_select(valid, d - vr, zero);
+        uxx = uxx + vux * vux;
+        uxy = uxy + vux * vuy;
+        uyy = uyy + vuy * vuy;
+        ux = ux + vux;
+        uy = uy + vuy;
+        count = count + cv::v_select(valid, one, zero);
+        uxr = uxr + vux * residual;
+        uyr = uyr + vuy * residual;
+        r = r + residual;
+    }
+    e.uxx = cv::v_reduce_sum(uxx);
+    e.uxy = cv::v_reduce_sum(uxy);
+    e.uyy = cv::v_reduce_sum(uyy);
+    e.ux = cv::v_reduce_sum(ux);
+    e.uy = cv::v_reduce_sum(uy);
+    e.count = cv::v_reduce_sum(count);
+    e.uxr = cv::v_reduce_sum(uxr);
+    e.uyr = cv::v_reduce_sum(uyr);
+    e.r = cv::v_reduce_sum(r);
+#endif
+    for(; i < n; i++) {
+        auto dx = (x[i] - origin.x) - cx;
+        auto dy = (y[i] - origin.y) - cy;
+        auto d = std::sqrt(dx * dx + dy * dy);
+        if(d <= 0.0f) {
+            continue;
+        }
+        auto ux = dx / d;
+        auto uy = dy / d;
+        auto residual = d - radius;
+        e.uxx += ux * ux;
+        e.uxy += ux * uy;
+        e.uyy += uy * uy;
+        e.ux += ux;
+        e.uy += uy;
+        e.count += 1.0;
+        e.uxr += ux * residual;
+        e.uyr += uy * residual;
+        e.r += residual;
+    }
+    return e;
+}
+
+cv::Vec3f fitCircleSeparated(const float* x, const float* y, int n, int iterations) {
+    if(n < 3) {
+        return {};
+    }
+    // Координаты относительно центра тяжести, округленного до float: разности с ним точны,
+    // поэтому суммы в float не теряют точность на больших изображениях
+    auto sx = 0.0, sy = 0.0;
+    for(int i = 0; i < n; i++) {
+        sx += x[i];
+        sy += y[i];
+    }
+    auto origin = cv::Point2f(static_cast<float>(sx / n), static_cast<float>(sy / n));
+    auto initial = fitTaubin(accumulateMoments(x, y, n, origin.x, origin.y), n);
+    if(!initial) {
+        return {};
+    }
+    auto circle = *initial;
+    for(int iteration = 0; iteration < iterations; iteration++) {
+        auto e = accumulateNormalEquations(x, y, n, origin,
+                                           static_cast<float>(circle[0]),
+                                           static_cast<float>(circle[1]),
+                                           static_cast<float>(circle[2]));
+        auto jtj = cv::Matx33d(e.uxx, e.uxy, e.ux,
+                               e.uxy, e.uyy, e.uy,
+                               e.ux, e.uy, e.count);
+        // Вырожденная система дает нулевой шаг
+        auto delta = jtj.solve(cv::Vec3d(e.uxr, e.uyr, e.r), cv::DECOMP_CHOLESKY);
+        circle += delta;
+        if(delta.dot(delta) < 1e-12) {
+            break;
+        }
+    }
+    if(!std::isfinite(circle[0]) || !std::isfinite(circle[1]) || !(circle[2] > 0.0)) {
+        return {};
+    }
+    return cv::Vec3f(static_cast<float>(origin.x + circle[0]),
+                     static_cast<float>(origin.y + circle[1]),
+                     static_cast<float>(circle[2]));
+}
+
+#if CV_SIMD128
+inline cv::v_float32x4 loadAsFloat(const uchar* ptr) {
+    return cv::v_cvt_f32(cv::v_reinterpret_as_s32(cv::v_load_expand_q(ptr)));
+}
+#endif
+
+// x0, y - координаты первого пиксела строки относительно центра окна
+void accumulateGradientRow(const uchar* prev, const uchar* cur, const uchar* next,
+                           int width, float x0, float y, float minGradient2,
+                           GradientMoments& m) {
+    int x = 0;
+#if CV_SIMD128
+    auto zero = cv::v_setzero_f32();
+    auto a11 = zero, a12 = zero, a22 = zero, b1 = zero, b2 = zero;
+    auto w = zero, wx = zero, wy = zero, wr = zero;
+    auto vx = cv::v_float32x4(x0, x0 + 1.0f, x0 + 2.0f, x0 + 3.0f);
+    auto vy = cv::v_setall_f32(y);
+    auto vy2 = vy * vy;
+    auto step = cv::v_setall_f32(4.0f);
+    auto threshold = cv::v_setall_f32(minGradient2);
+    for(; x <= width - 4; x += 4) {
+        auto gx = loadAsFloat(cur + x + 1) - loadAsFloat(cur + x - 1);
+        auto gy = loadAsFloat(next + x) - loadAsFloat(prev + x);
+        auto gx2 = gx * gx;
+        auto gy2 = gy * gy;
+        auto mag = gx2 + gy2;
+        auto mask = mag >= threshold;
+        gx2 = cv::v_select(mask, gx2, zero);
+        gy2 = cv::v_select(mask, gy2, zero);
+        mag = cv::v_select(mask, mag, zero);
+        auto gxy = cv::v_select(mask, gx * gy, zero);
+        a11 = a11 + gy2;
+        a12 = a12 - gxy;
+        a22 = a22 + gx2;
+        b1 = b1 + gy2 * vx - gxy * vy;
+        b2 = b2 + gx2 * vy - gxy * vx;
+        w = w + mag;
+        wx = wx + mag * vx;
+        wy = wy + mag * vy;
+        wr = wr + mag * (vx * vx + vy2);
+        vx = vx + step;
+    }
+    m.a11 += cv::v_reduce_sum(a11);
+    m.a12 += cv::v_reduce_sum(a12);
+    m.a22 += cv::v_reduce_sum(a22);
+    m.b1 += cv::v_reduce_sum(b1);
+    m.b2 += cv::v_reduce_sum(b2);
+    m.w += cv::v_reduce_sum(w);
+    m.wx += cv::v_reduce_sum(wx);
+    m.wy += cv::v_reduce_sum(wy);
+    m.wr += cv::v_reduce_sum(wr);
+#endif
+    for(; x < width; x++) {
+        auto gx = static_cast<float>(cur[x + 1]) - cur[x - 1];
+        auto gy = static_cast<float>(next[x]) - prev[x];
+        auto mag = gx * gx + gy * gy;
+        if(mag < minGradient2) {
+            continue;
+        }
+        auto px = x0 + x;
+        m.a11 += gy * gy;
+        m.a12 -= gx * gy;
+        m.a22 += gx * gx;
+        m.b1 += gy * gy * px - gx * gy * y;
+        m.b2 += gx * gx * y - gx * gy * px;
+        m.w += mag;
+        m.wx += mag * px;
+        m.wy += mag * y;
+        m.wr += mag * (px * px + y * y);
+    }
+}
+
 }
 
 namespace camcalib {
 
 std::optional<cv::Vec3f> fitCircleCeres(const std::vector<cv::Point2f> &samples) {
+    CAMCALIB_TRACE_SCOPE("fitCircleCeres");
     auto initial = findInitialGuess(samples);
     auto circle = initial;
     ceres::Problem problem;
@@ -51,5 +336,78 @@ std::optional<cv::Vec3f> fitCircleCeres(const std::vector<cv::Point2f> &samples)
     return std::nullopt;
 }
 
+void PointSets::add(const cv::Mat &points) {
+    CV_Assert(points.empty() || (points.type() == CV_32FC2 && points.isContinuous()));
+    auto count = static_cast<int>(points.total());
+    auto data = points.ptr<cv::Point2f>();
+    for(int i = 0; i < count; i++) {
+        x.push_back(data[i].x);
+        y.push_back(data[i].y);
+    }
+    offsets.push_back(offsets.back() + count);
+}
+
+std::vector<cv::Vec3f> fitCircles(const PointSets &sets, int iterations) {
+    CAMCALIB_TRACE_SCOPE("fitCircles");
+    std::vector<int> indices(sets.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::vector<cv::Vec3f> circles(sets.size());
+    std::transform(std::execution::par,
+                   indices.begin(),
+                   indices.end(),
+                   circles.begin(),
+                   [&](int index) {
+                       auto first = sets.offsets[index];
+                       auto count = sets.offsets[index + 1] - first;
+                       return fitCircleSeparated(sets.x.data() + first, sets.y.data() + first, count, iterations);
+                   });
+    return circles;
+}
+
+std::optional<cv::Vec3f> fitCircleGeometric(const std::vector<cv::Point2f> &samples, int iterations) {
+    PointSets sets;
+    sets.add(cv::Mat(samples));
+    auto circle = fitCircleSeparated(sets.x.data(), sets.y.data(), static_cast<int>(samples.size()), iterations);
+    if(circle[2] <= 0.0f) {
+        return std::nullopt;
+    }
+    return circle;
+}
+
+std::optional<cv::Vec3f> fitCircleGradient(const cv::Mat &image, const cv::Rect &patch, float minGradient) {
+    CAMCALIB_TRACE_SCOPE("fitCircleGradient");
+    assert(image.type() == CV_8U);
+    assert((patch & cv::Rect(1, 1, image.cols - 2, image.rows - 2)) == patch);
+    if(patch.empty()) {
+        return std::nullopt;
+    }
+    // Координаты относительно центра окна, чтобы суммы квадратов не теряли точность
+    auto center = cv::Point2f(patch.x + 0.5f * (patch.width - 1),
+                              patch.y + 0.5f * (patch.height - 1));
+    auto x0 = patch.x - center.x;
+    auto minGradient2 = minGradient * minGradient;
+    GradientMoments m;
+    for(int row = patch.y; row < patch.br().y; row++) {
+        accumulateGradientRow(image.ptr<uchar>(row - 1) + patch.x,
+                              image.ptr<uchar>(row) + patch.x,
+                              image.ptr<uchar>(row + 1) + patch.x,
+                              patch.width, x0, row - center.y, minGradient2, m);
+    }
+    auto det = m.a11 * m.a22 - m.a12 * m.a12;
+    auto trace = m.a11 + m.a22;
+    if(m.w <= 0.0 || det <= 1e-6 * trace * trace) {
+        return std::nullopt;
+    }
+    auto cx = (m.a22 * m.b1 - m.a12 * m.b2) / det;
+    auto cy = (m.a11 * m.b2 - m.a12 * m.b1) / det;
+    auto r2 = (m.wr - 2.0 * (cx * m.wx + cy * m.wy)) / m.w + cx * cx + cy * cy;
+    if(r2 <= 0.0) {
+        return std::nullopt;
+    }
+    return cv::Vec3f(static_cast<float>(cx + center.x),
+                     static_cast<float>(cy + center.y),
+                     static_cast<float>(std::sqrt(r2)));
+}
+
 
 }
@@ -2,9 +2,36 @@
 
 #include <opencv2/core.hpp>
 #include <optional>
+#include <vector>
 
 namespace camcalib {
 
 std::optional<cv::Vec3f> fitCircleCeres(const std::vector<cv::Point2f>& samples);
 
+// Наборы точек в раздельных массивах координат:
+// набор i - элементы offsets[i] ... offsets[i + 1] - 1
+struct PointSets {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<int> offsets{0};
+
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+    // points - CV_32FC2
+    void add(const cv::Mat& points);
+};
+
+// Геометрическая подгонка окружностей: алгебраическая оценка Таубина и до iterations
+// шагов Гаусса-Ньютона по расстояниям до окружности. Наборы обрабатываются параллельно.
+// Для набора меньше трех точек или вырожденного результат - нулевая окружность.
+std::vector<cv::Vec3f> fitCircles(const PointSets& sets, int iterations = 3);
+std::optional<cv::Vec3f> fitCircleGeometric(const std::vector<cv::Point2f>& samples, int iterations = 3);
+
+// Оценка окружности по полутоновому изображению CV_8U за один проход:
+// центр - точка, ближайшая к прямым вдоль градиента, радиус - взвешенное по |grad|^2
+// расстояние до центра. Учитываются пикселы с |grad| >= minGradient (центральные разности).
+// patch не должен касаться границы изображения.
+std::optional<cv::Vec3f> fitCircleGradient(const cv::Mat& image, const cv::Rect& patch, float minGradient);
+
 }
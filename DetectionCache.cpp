@@ -0,0 +1,113 @@
+#include "DetectionCache.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace camcalib {
+
+static size_t sizeOf(const CachedComponents& components, const cv::Mat& source) {
+    const auto& c = components.components;
+    auto size = c.rects.size() * sizeof(cv::Rect)
+        + c.offsets.size() * sizeof(int)
+        + c.points.size() * sizeof(cv::Point2f);
+    // Растянутая до 8 бит копия 16-битного изображения
+    if(components.searchImage.datastart != source.datastart) {
+        size += components.searchImage.total() * components.searchImage.elemSize();
+    }
+    return size;
+}
+
+static size_t sizeOf(const ComponentFits& fits) {
+    return fits.circles.size() * sizeof(cv::Vec3f) + fits.fitted.size() / 8;
+}
+
+DetectionCache::DetectionCache(cv::Mat image, size_t memoryBudget)
+    : mImage{std::move(image)}, mMemoryBudget{memoryBudget} {
+}
+
+bool DetectionCache::isSourceOf(const cv::Mat &image) const {
+    return image.data == mImage.data
+        && image.size() == mImage.size()
+        && image.type() == mImage.type()
+        && image.step == mImage.step;
+}
+
+std::shared_ptr<const CachedComponents> DetectionCache::findComponents(const cv::Rect &searchRect,
+                                                                       double edgeStrength,
+                                                                       const std::vector<cv::Rect> &excludedRegions,
+                                                                       const std::optional<cv::Vec2d> &intensityRange) {
+    std::lock_guard lock{mMutex};
+    auto entry = std::find_if(mEntries.begin(), mEntries.end(), [&](const Entry& e) {
+        const auto& c = *e.components;
+        return c.searchRect == searchRect && c.edgeStrength == edgeStrength
+            && c.excludedRegions == excludedRegions && c.intensityRange == intensityRange;
+    });
+    if(entry == mEntries.end()) {
+        return nullptr;
+    }
+    mEntries.splice(mEntries.begin(), mEntries, entry);
+    return entry->components;
+}
+
+void DetectionCache::insertComponents(std::shared_ptr<const CachedComponents> components) {
+    std::lock_guard lock{mMutex};
+    auto size = sizeOf(*components, mImage);
+    mEntries.push_front(Entry{std::move(components), {}, size, 0});
+    mMemoryUsage += size;
+    evict();
+}
+
+std::shared_ptr<const ComponentFits> DetectionCache::findFits(const CachedComponents *components,
+                                                              CircleFitMethod method) {
+    std::lock_guard lock{mMutex};
+    auto entry = findEntry(components);
+    if(entry == mEntries.end()) {
+        return nullptr;
+    }
+    auto fits = entry->fits.find(method);
+    return fits != entry->fits.end() ? fits->second : nullptr;
+}
+
+void DetectionCache::insertFits(const CachedComponents *components,
+                                CircleFitMethod method,
+                                std::shared_ptr<const ComponentFits> fits) {
+    std::lock_guard lock{mMutex};
+    auto entry = findEntry(components);
+    if(entry == mEntries.end()) {
+        return;
+    }
+    auto& stored = entry->fits[method];
+    if(stored) {
+        auto size = sizeOf(*stored);
+        entry->fitsSize -= size;
+        mMemoryUsage -= size;
+    }
+    stored = std::move(fits);
+    auto size = sizeOf(*stored);
+    entry->fitsSize += size;
+    mMemoryUsage += size;
+    mEntries.splice(mEntries.begin(), mEntries, entry);
+    evict();
+}
+
+size_t DetectionCache::getMemoryUsage() const {
+    std::lock_guard lock{mMutex};
+    return mMemoryUsage;
+}
+
+std::list<DetectionCache::Entry>::iterator DetectionCache::findEntry(const CachedComponents *components) {
+    return std::find_if(mEntries.begin(), mEntries.end(), [components](const Entry& e) {
+        return e.components.get() == components;
+    });
+}
+
+void DetectionCache::evict() {
+    // Последняя запись остается, даже если одна превышает бюджет
+    while(mMemoryUsage > mMemoryBudget && mEntries.size() > 1) {
+        const auto& last = mEntries.back();
+        mMemoryUsage -= last.componentsSize + last.fitsSize;
+        mEntries.pop_back();
+    }
+    CAMCALIB_TRACE_COUNTER("detectionCacheBytes", mMemoryUsage);
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Calibration.h"
+#include "EdgeComponents.h"
+#include <opencv2/core.hpp>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace camcalib {
+
+// Компоненты краев области поиска и параметры, от которых они зависят
+struct CachedComponents {
+    cv::Rect searchRect;
+    double edgeStrength{};
+    std::vector<cv::Rect> excludedRegions;
+    // GridSearchParams::intensityRange запроса
+    std::optional<cv::Vec2d> intensityRange;
+    // 8-битное изображение searchRect, для 8-битного источника - его часть без копирования
+    cv::Mat searchImage;
+    // Координаты относительно searchRect
+    EdgeComponents components;
+};
+
+// Окружности компонент, подгоняются по мере запроса. Нулевой радиус - подгонка не удалась.
+struct ComponentFits {
+    std::vector<cv::Vec3f> circles;
+    std::vector<bool> fitted;
+};
+
+// Промежуточные результаты поиска меток на одном изображении (GridSearchParams::cache).
+// Подходят компоненты, размеченные в той же области поиска с теми же порогом,
+// исключенными областями и диапазоном яркости (края у границы и подгонка зависят от области, результат
+// совпадает с поиском без кэша), поэтому изменение шага, размера сетки или метода
+// подгонки не повторяет поиск краев и разметку. Подгоняются только компоненты,
+// для которых окружность еще не найдена этим методом.
+// Записи вытесняются по давности использования, когда их объем превышает memoryBudget байт.
+// Потокобезопасен, одновременные промахи по одному ключу вычисляются независимо.
+class DetectionCache {
+public:
+    static constexpr size_t DefaultMemoryBudget = size_t{256} << 20;
+    explicit DetectionCache(cv::Mat image, size_t memoryBudget = DefaultMemoryBudget);
+    // image - изображение, для которого создан кэш (тот же буфер)
+    bool isSourceOf(const cv::Mat& image) const;
+    std::shared_ptr<const CachedComponents> findComponents(const cv::Rect& searchRect,
+                                                           double edgeStrength,
+                                                           const std::vector<cv::Rect>& excludedRegions,
+                                                           const std::optional<cv::Vec2d>& intensityRange);
+    void insertComponents(std::shared_ptr<const CachedComponents> components);
+    std::shared_ptr<const ComponentFits> findFits(const CachedComponents* components, CircleFitMethod method);
+    // Не сохраняются, если компоненты уже вытеснены
+    void insertFits(const CachedComponents* components,
+                    CircleFitMethod method,
+                    std::shared_ptr<const ComponentFits> fits);
+    size_t getMemoryUsage() const;
+private:
+    struct Entry {
+        std::shared_ptr<const CachedComponents> components;
+        std::map<CircleFitMethod, std::shared_ptr<const ComponentFits>> fits;
+        size_t componentsSize{};
+        size_t fitsSize{};
+    };
+    std::list<Entry>::iterator findEntry(const CachedComponents* components);
+    void evict();
+    cv::Mat mImage;
+    size_t mMemoryBudget;
+    mutable std::mutex mMutex;
+    // Последняя использованная запись - первая
+    std::list<Entry> mEntries;
+    size_t mMemoryUsage{};
+};
+
+}
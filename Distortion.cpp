@@ -0,0 +1,59 @@
+#include "Distortion.h"
+
+namespace camcalib {
+
+cv::Point2d distortionShift(const LensDistortion& d, const cv::Point2d& point) {
+    auto du = point.x - d.center.x;
+    auto dv = point.y - d.center.y;
+    auto r = du * du + dv * dv;
+    return {
+        d.k1 * du * r + d.k2 * du * r * r + d.p1 * (3.0 * du * du + dv * dv) + d.p2 * 2.0 * du * dv + d.s1 * r,
+        d.k1 * dv * r + d.k2 * dv * r * r + d.p1 * 2.0 * du * dv + d.p2 * (du * du + 3.0 * dv * dv) + d.s2 * r
+    };
+}
+
+cv::Point2d undistortPoint(const LensDistortion& distortion, const cv::Point2d& point) {
+    return point - distortionShift(distortion, point);
+}
+
+cv::Point2d distortPoint(const LensDistortion& distortion, const cv::Point2d& undistorted) {
+    auto point = undistorted;
+    for(int iteration = 0; iteration < 100; iteration++) {
+        auto next = undistorted + distortionShift(distortion, point);
+        auto delta = next - point;
+        point = next;
+        if(delta.dot(delta) < 1e-20) {
+            break;
+        }
+    }
+    return point;
+}
+
+void writeDistortion(cv::FileStorage& storage, const std::string& name, const LensDistortion& distortion) {
+    storage << name << "{"
+            << "center" << distortion.center
+            << "k1" << distortion.k1
+            << "k2" << distortion.k2
+            << "p1" << distortion.p1
+            << "p2" << distortion.p2
+            << "s1" << distortion.s1
+            << "s2" << distortion.s2
+            << "}";
+}
+
+LensDistortion readDistortion(const cv::FileNode& node) {
+    LensDistortion distortion;
+    if(node.empty()) {
+        return distortion;
+    }
+    node["center"] >> distortion.center;
+    node["k1"] >> distortion.k1;
+    node["k2"] >> distortion.k2;
+    node["p1"] >> distortion.p1;
+    node["p2"] >> distortion.p2;
+    node["s1"] >> distortion.s1;
+    node["s2"] >> distortion.s2;
+    return distortion;
+}
+
+}
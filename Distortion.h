@@ -0,0 +1,30 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace camcalib {
+
+// Дисторсия в модели CalibrationCostFunction, коэффициенты в пикселах изображения:
+// неискаженная точка p - sigma(p - center),
+// sigma_u = k1 du r + k2 du r^2 + p1 (3 du^2 + dv^2) + 2 p2 du dv + s1 r,
+// sigma_v = k1 dv r + k2 dv r^2 + 2 p1 du dv + p2 (du^2 + 3 dv^2) + s2 r, r = du^2 + dv^2
+struct LensDistortion {
+    cv::Point2d center{};
+    double k1{0.0};
+    double k2{0.0};
+    double p1{0.0};
+    double p2{0.0};
+    double s1{0.0};
+    double s2{0.0};
+};
+
+cv::Point2d distortionShift(const LensDistortion& distortion, const cv::Point2d& point);
+cv::Point2d undistortPoint(const LensDistortion& distortion, const cv::Point2d& point);
+// Обратное преобразование простой итерацией, сходится при |d sigma / dp| < 1
+cv::Point2d distortPoint(const LensDistortion& distortion, const cv::Point2d& undistorted);
+
+void writeDistortion(cv::FileStorage& storage, const std::string& name, const LensDistortion& distortion);
+// Пустой узел - нулевая дисторсия
+LensDistortion readDistortion(const cv::FileNode& node);
+
+}
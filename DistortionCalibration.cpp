@@ -0,0 +1,254 @@
+#include "DistortionCalibration.h"
+#include "DistortionCostFunction.h"
+#include "SolverProgress.h"
+#include "Trace.h"
+#include <ceres/ceres.h>
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+namespace camcalib {
+
+namespace {
+
+using Transform = std::array<double, 6>;
+using DistortionParams = std::array<double, 8>;
+
+// Начальное приближение - аффинное преобразование без дисторсии (МНК в центрированных координатах)
+std::optional<Transform> fitAffine(const DistortionView& view) {
+    const auto count = view.centersImage.size();
+    cv::Point2d meanImage{}, meanWorld{};
+    for(size_t i = 0; i < count; i++) {
+        meanImage += cv::Point2d(view.centersImage[i]);
+        meanWorld += cv::Point2d(view.centersWorld[i]);
+    }
+    meanImage *= 1.0 / count;
+    meanWorld *= 1.0 / count;
+    cv::Matx22d ata{};
+    cv::Matx22d atb{};
+    for(size_t i = 0; i < count; i++) {
+        auto p = cv::Point2d(view.centersImage[i]) - meanImage;
+        auto w = cv::Point2d(view.centersWorld[i]) - meanWorld;
+        ata += cv::Matx22d(p.x * p.x, p.x * p.y,
+                           p.x * p.y, p.y * p.y);
+        atb += cv::Matx22d(p.x * w.x, p.x * w.y,
+                           p.y * w.x, p.y * w.y);
+    }
+    cv::Matx22d m;
+    if(!cv::solve(ata, atb, m, cv::DECOMP_CHOLESKY)) {
+        return std::nullopt;
+    }
+    // Столбцы m - строки преобразования
+    return Transform{m(0, 0), m(1, 0), meanWorld.x - m(0, 0) * meanImage.x - m(1, 0) * meanImage.y,
+                     m(0, 1), m(1, 1), meanWorld.y - m(0, 1) * meanImage.x - m(1, 1) * meanImage.y};
+}
+
+LensDistortion toPixels(const DistortionParams& d, double scale) {
+    using F = DistortionCostFunction;
+    LensDistortion result;
+    result.center = {d[F::_x0], d[F::_y0]};
+    result.k1 = d[F::_k1] / (scale * scale);
+    result.k2 = d[F::_k2] / (scale * scale * scale * scale);
+    result.p1 = d[F::_p1] / scale;
+    result.p2 = d[F::_p2] / scale;
+    result.s1 = d[F::_s1] / scale;
+    result.s2 = d[F::_s2] / scale;
+    return result;
+}
+
+// Ковариация нормированных параметров дисторсии с учетом неопределенности преобразований снимков
+std::optional<cv::Matx<double, 8, 8>> estimateCovariance(ceres::Problem& problem,
+                                                          DistortionParams& distortion,
+                                                          double residualVariance) {
+    CAMCALIB_TRACE_SCOPE("ceres::Covariance distortion");
+    ceres::Covariance::Options options;
+    // Плотное SVD не требует SuiteSparse и отвергает почти вырожденные задачи
+    options.algorithm_type = ceres::DENSE_SVD;
+    options.num_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    ceres::Covariance covariance(options);
+    const auto blocks = std::vector<std::pair<const double*, const double*>>{
+        {distortion.data(), distortion.data()}
+    };
+    if(!covariance.Compute(blocks, &problem)) {
+        return std::nullopt;
+    }
+    cv::Matx<double, 8, 8> result;
+    if(!covariance.GetCovarianceBlock(distortion.data(), distortion.data(), result.val)) {
+        return std::nullopt;
+    }
+    return result * residualVariance;
+}
+
+double conditionNumber(const cv::Matx<double, 8, 8>& covariance, const std::vector<int>& constantParams) {
+    std::vector<int> free;
+    for(int i = 0; i < 8; i++) {
+        if(std::find(constantParams.begin(), constantParams.end(), i) == constantParams.end()) {
+            free.push_back(i);
+        }
+    }
+    cv::Mat block(static_cast<int>(free.size()), static_cast<int>(free.size()), CV_64F);
+    for(size_t i = 0; i < free.size(); i++) {
+        for(size_t j = 0; j < free.size(); j++) {
+            block.at<double>(static_cast<int>(i), static_cast<int>(j)) = covariance(free[i], free[j]);
+        }
+    }
+    cv::Mat eigenvalues;
+    cv::eigen(block, eigenvalues);
+    double minValue, maxValue;
+    cv::minMaxLoc(eigenvalues, &minValue, &maxValue);
+    return minValue > 0.0 ? maxValue / minValue : std::numeric_limits<double>::infinity();
+}
+
+}
+
+std::optional<DistortionCalibrationResult> calibrateDistortion(const std::vector<DistortionView>& views,
+                                                               cv::Size imageSize,
+                                                               const DistortionCalibrationOptions& options,
+                                                               const ProgressCallback& progress) {
+    CAMCALIB_TRACE_SCOPE("calibrateDistortion");
+    if(views.empty() || imageSize.empty()) {
+        return std::nullopt;
+    }
+    size_t pointsCount = 0;
+    for(const auto& view: views) {
+        if(view.centersImage.size() != view.centersWorld.size() || view.centersImage.size() < 3) {
+            std::cerr << __FUNCTION__": each view needs at least 3 correspondences" << std::endl;
+            return std::nullopt;
+        }
+        pointsCount += view.centersImage.size();
+    }
+    if(2 * pointsCount < 6 * views.size() + 8) {
+        std::cerr << __FUNCTION__": not enough correspondences" << std::endl;
+        return std::nullopt;
+    }
+    if(!reportStage(progress, CalibrationStage::Solve)) {
+        return std::nullopt;
+    }
+
+    // Половина диагонали: нормированный радиус не больше единицы
+    const auto scale = 0.5 * std::hypot(imageSize.width, imageSize.height);
+    std::vector<Transform> transforms;
+    transforms.reserve(views.size());
+    for(const auto& view: views) {
+        auto transform = fitAffine(view);
+        if(!transform) {
+            std::cerr << __FUNCTION__": degenerate view" << std::endl;
+            return std::nullopt;
+        }
+        transforms.push_back(*transform);
+    }
+    DistortionParams distortion{0.5 * (imageSize.width - 1), 0.5 * (imageSize.height - 1)};
+
+    ceres::Problem problem;
+    for(size_t i = 0; i < views.size(); i++) {
+        const auto& view = views[i];
+        for(size_t j = 0; j < view.centersImage.size(); j++) {
+            auto cost = new DistortionCostFunction(view.centersWorld[j], view.centersImage[j], scale);
+            problem.AddResidualBlock(cost, nullptr, transforms[i].data(), distortion.data());
+        }
+    }
+    std::vector<int> constantParams;
+    using F = DistortionCostFunction;
+    if(!options.estimateCenter) {
+        constantParams.insert(constantParams.end(), {F::_x0, F::_y0});
+    }
+    if(!options.estimateTangential) {
+        constantParams.insert(constantParams.end(), {F::_p1, F::_p2});
+    }
+    if(!options.estimatePrism) {
+        constantParams.insert(constantParams.end(), {F::_s1, F::_s2});
+    }
+    if(!constantParams.empty()) {
+        problem.SetManifold(distortion.data(), new ceres::SubsetManifold(static_cast<int>(distortion.size()), constantParams));
+    }
+
+    ProgressIterationCallback callback{progress};
+    ceres::Solver::Options solverOptions;
+    // Блоки снимков исключаются первыми, остается система 8 x 8 для дисторсии
+    solverOptions.linear_solver_type = ceres::DENSE_SCHUR;
+    auto ordering = std::make_shared<ceres::ParameterBlockOrdering>();
+    for(auto& transform: transforms) {
+        ordering->AddElementToGroup(transform.data(), 0);
+    }
+    ordering->AddElementToGroup(distortion.data(), 1);
+    solverOptions.linear_solver_ordering = ordering;
+    solverOptions.num_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    solverOptions.max_num_iterations = options.maxIterations;
+    solverOptions.callbacks.push_back(&callback);
+    ceres::Solver::Summary summary;
+    {
+        CAMCALIB_TRACE_SCOPE("ceres::Solve distortion");
+        ceres::Solve(solverOptions, &problem, &summary);
+    }
+    CAMCALIB_TRACE_COUNTER("distortionIterations", summary.iterations.size());
+    if(summary.termination_type == ceres::USER_FAILURE || !summary.IsSolutionUsable()) {
+        return std::nullopt;
+    }
+
+    DistortionCalibrationResult result;
+    result.distortion = toPixels(distortion, scale);
+    auto errorSum = 0.0;
+    for(size_t i = 0; i < views.size(); i++) {
+        const auto& q = transforms[i];
+        result.imageToWorld.emplace_back(q[0], q[1], q[2], q[3], q[4], q[5]);
+        // Невязка в мировых координатах переводится в пикселы
+        auto worldToImage = cv::Matx22d(q[0], q[1], q[3], q[4]).inv();
+        const auto& view = views[i];
+        auto viewSum = 0.0;
+        for(size_t j = 0; j < view.centersImage.size(); j++) {
+            auto u = undistortPoint(result.distortion, view.centersImage[j]);
+            auto w = cv::Point2d(q[0] * u.x + q[1] * u.y + q[2], q[3] * u.x + q[4] * u.y + q[5]);
+            auto r = worldToImage * cv::Vec2d(w - cv::Point2d(view.centersWorld[j]));
+            viewSum += r.dot(r);
+        }
+        errorSum += viewSum;
+        result.viewRmsErrors.push_back(std::sqrt(viewSum / view.centersImage.size()));
+    }
+    result.rmsError = std::sqrt(errorSum / pointsCount);
+
+    // Дисперсия невязки (мировые единицы) по числу степеней свободы
+    const auto freeParams = 6 * views.size() + distortion.size() - constantParams.size();
+    const auto residualVariance = 2.0 * summary.final_cost / std::max<double>(1.0, 2.0 * pointsCount - freeParams);
+    if(auto covariance = estimateCovariance(problem, distortion, residualVariance)) {
+        result.conditionNumber = conditionNumber(*covariance, constantParams);
+        // Перевод нормированных параметров в единицы LensDistortion (toPixels)
+        const double units[8] = {1.0, 1.0,
+                                 1.0 / (scale * scale), 1.0 / (scale * scale * scale * scale),
+                                 1.0 / scale, 1.0 / scale, 1.0 / scale, 1.0 / scale};
+        for(int i = 0; i < 8; i++) {
+            for(int j = 0; j < 8; j++) {
+                (*covariance)(i, j) *= units[i] * units[j];
+            }
+        }
+        result.covariance = covariance;
+    } else {
+        std::cerr << __FUNCTION__": covariance is undefined, distortion parameters are degenerate" << std::endl;
+    }
+
+    std::ostringstream os;
+    os << summary.BriefReport() << std::endl;
+    const auto& d = result.distortion;
+    os << "center: " << d.center << std::endl
+       << "k1: " << d.k1 << " k2: " << d.k2 << std::endl
+       << "p1: " << d.p1 << " p2: " << d.p2 << std::endl
+       << "s1: " << d.s1 << " s2: " << d.s2 << std::endl
+       << "rms, px: " << result.rmsError << std::endl;
+    if(result.covariance) {
+        const auto& c = *result.covariance;
+        auto deviation = [&c](int i) { return std::sqrt(c(i, i)); };
+        os << "center +-: (" << deviation(F::_x0) << ", " << deviation(F::_y0) << ")" << std::endl
+           << "k1 +-: " << deviation(F::_k1) << " k2 +-: " << deviation(F::_k2) << std::endl
+           << "p1 +-: " << deviation(F::_p1) << " p2 +-: " << deviation(F::_p2) << std::endl
+           << "s1 +-: " << deviation(F::_s1) << " s2 +-: " << deviation(F::_s2) << std::endl
+           << "condition number: " << result.conditionNumber << std::endl;
+    } else {
+        os << "covariance: undefined (degenerate parameters)" << std::endl;
+    }
+    result.report = os.str();
+    return result;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Distortion.h"
+#include "Progress.h"
+#include <opencv2/core.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace camcalib {
+
+// Соответствия метки изображения - узлы сетки для одного снимка
+struct DistortionView {
+    std::vector<cv::Point2f> centersImage;
+    std::vector<cv::Point2f> centersWorld;
+};
+
+struct DistortionCalibrationOptions {
+    // Центр дисторсии почти вырожден с p1, p2, s1, s2 при малой радиальной составляющей,
+    // по умолчанию он фиксирован в центре изображения
+    bool estimateCenter{false};
+    bool estimateTangential{true};
+    bool estimatePrism{true};
+    int maxIterations{100};
+};
+
+struct DistortionCalibrationResult {
+    LensDistortion distortion;
+    // Для каждого снимка: неискаженные координаты изображения в мировые
+    std::vector<cv::Matx23d> imageToWorld;
+    // Среднеквадратичная невязка, пикселы
+    double rmsError{};
+    std::vector<double> viewRmsErrors;
+    // Ковариация параметров дисторсии в порядке x0, y0, k1, k2, p1, p2, s1, s2
+    // (единицы LensDistortion), строки и столбцы фиксированных параметров нулевые.
+    // Пустая, если матрица Якоби вырождена.
+    std::optional<cv::Matx<double, 8, 8>> covariance;
+    // Отношение наибольшего и наименьшего собственных чисел ковариации оцениваемых
+    // параметров в нормированных единицах; большие значения - параметры почти неразличимы
+    double conditionNumber{};
+    std::string report;
+};
+
+// Совместная оценка дисторсии (CalibrationCostFunction) и аффинного преобразования
+// каждого снимка. Снимки одного объектива и увеличения; imageSize задает масштаб
+// нормировки коэффициентов. progress вызывается с этапом Solve на каждой итерации.
+std::optional<DistortionCalibrationResult> calibrateDistortion(const std::vector<DistortionView>& views,
+                                                               cv::Size imageSize,
+                                                               const DistortionCalibrationOptions& options = {},
+                                                               const ProgressCallback& progress = {});
+
+}
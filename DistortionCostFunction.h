@@ -0,0 +1,95 @@
+#pragma once
+
+#include <ceres/sized_cost_function.h>
+#include <opencv2/core.hpp>
+
+namespace camcalib {
+
+// CalibrationCostFunction с разделенными блоками параметров и аналитическими производными:
+// преобразование снимка (6) и общая для всех снимков дисторсия (8).
+// Коэффициенты дисторсии нормированы на масштаб scale:
+// k1 * scale^2, k2 * scale^4, p1 * scale, p2 * scale, s1 * scale, s2 * scale,
+// чтобы все параметры блока были одного порядка.
+class DistortionCostFunction : public ceres::SizedCostFunction<2, 6, 8> {
+public:
+    enum TransformIndices {
+        _q11 = 0,
+        _q12 = 1,
+        _q13 = 2,
+        _q21 = 3,
+        _q22 = 4,
+        _q23 = 5
+    };
+    enum DistortionIndices {
+        _x0 = 0,
+        _y0 = 1,
+        _k1 = 2,
+        _k2 = 3,
+        _p1 = 4,
+        _p2 = 5,
+        _s1 = 6,
+        _s2 = 7
+    };
+    DistortionCostFunction(const cv::Point2d& worldPoint,
+                           const cv::Point2d& imagePoint,
+                           double scale)
+        : mWorldPoint{worldPoint}, mImagePoint{imagePoint}, mScale{scale} {
+    }
+    bool Evaluate(double const* const* parameters, double* residuals, double** jacobians) const override {
+        const auto q = parameters[0];
+        const auto d = parameters[1];
+        const auto S = mScale;
+        const auto a = (mImagePoint.x - d[_x0]) / S;
+        const auto b = (mImagePoint.y - d[_y0]) / S;
+        const auto R = a * a + b * b;
+        const auto ab = a * b;
+        // sigma = S * f(a, b)
+        const auto fu = d[_k1] * a * R + d[_k2] * a * R * R +
+                        d[_p1] * (3.0 * a * a + b * b) + d[_p2] * 2.0 * ab + d[_s1] * R;
+        const auto fv = d[_k1] * b * R + d[_k2] * b * R * R +
+                        d[_p1] * 2.0 * ab + d[_p2] * (a * a + 3.0 * b * b) + d[_s2] * R;
+        const auto u = mImagePoint.x - S * fu;
+        const auto v = mImagePoint.y - S * fv;
+        residuals[0] = q[_q11] * u + q[_q12] * v + q[_q13] - mWorldPoint.x;
+        residuals[1] = q[_q21] * u + q[_q22] * v + q[_q23] - mWorldPoint.y;
+        if(jacobians == nullptr) {
+            return true;
+        }
+        if(auto J = jacobians[0]; J != nullptr) {
+            J[0] = u; J[1] = v; J[2] = 1.0; J[3] = 0.0; J[4] = 0.0; J[5] = 0.0;
+            J[6] = 0.0; J[7] = 0.0; J[8] = 0.0; J[9] = u; J[10] = v; J[11] = 1.0;
+        }
+        if(auto J = jacobians[1]; J != nullptr) {
+            // Производные сдвига (su, sv) по параметрам дисторсии
+            const auto dfuda = d[_k1] * (R + 2.0 * a * a) + d[_k2] * (R * R + 4.0 * a * a * R) +
+                               6.0 * d[_p1] * a + 2.0 * d[_p2] * b + 2.0 * d[_s1] * a;
+            const auto dfudb = d[_k1] * 2.0 * ab + d[_k2] * 4.0 * ab * R +
+                               2.0 * d[_p1] * b + 2.0 * d[_p2] * a + 2.0 * d[_s1] * b;
+            const auto dfvda = d[_k1] * 2.0 * ab + d[_k2] * 4.0 * ab * R +
+                               2.0 * d[_p1] * b + 2.0 * d[_p2] * a + 2.0 * d[_s2] * a;
+            const auto dfvdb = d[_k1] * (R + 2.0 * b * b) + d[_k2] * (R * R + 4.0 * b * b * R) +
+                               2.0 * d[_p1] * a + 6.0 * d[_p2] * b + 2.0 * d[_s2] * b;
+            // da/dx0 = -1/S, sigma = S * f
+            const double su[8] = {-dfuda, -dfudb,
+                                  S * a * R, S * a * R * R,
+                                  S * (3.0 * a * a + b * b), S * 2.0 * ab,
+                                  S * R, 0.0};
+            const double sv[8] = {-dfvda, -dfvdb,
+                                  S * b * R, S * b * R * R,
+                                  S * 2.0 * ab, S * (a * a + 3.0 * b * b),
+                                  0.0, S * R};
+            for(int i = 0; i < 8; i++) {
+                J[i] = -(q[_q11] * su[i] + q[_q12] * sv[i]);
+                J[8 + i] = -(q[_q21] * su[i] + q[_q22] * sv[i]);
+            }
+        }
+        return true;
+    }
+
+private:
+    cv::Point2d mWorldPoint;
+    cv::Point2d mImagePoint;
+    double mScale;
+};
+
+}
@@ -0,0 +1,145 @@
+#include "EdgeComponents.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Временная метка: система непересекающихся множеств, рамка и список точек
+class ProvisionalLabels {
+public:
+    ProvisionalLabels() {
+        // Метка 0 - фон
+        mLabels.emplace_back();
+    }
+    int create() {
+        auto label = static_cast<int>(mLabels.size());
+        auto& data = mLabels.emplace_back();
+        data.parent = label;
+        return label;
+    }
+    int find(int label) {
+        while(mLabels[label].parent != label) {
+            mLabels[label].parent = mLabels[mLabels[label].parent].parent;
+            label = mLabels[label].parent;
+        }
+        return label;
+    }
+    int unite(int root, int label) {
+        auto other = find(label);
+        if(other == root) {
+            return root;
+        }
+        // Корнем остается более ранняя метка, порядок компонент как у построчного обхода
+        if(other < root) {
+            std::swap(root, other);
+        }
+        auto& dst = mLabels[root];
+        auto& src = mLabels[other];
+        src.parent = root;
+        dst.bounds.minX = std::min(dst.bounds.minX, src.bounds.minX);
+        dst.bounds.minY = std::min(dst.bounds.minY, src.bounds.minY);
+        dst.bounds.maxX = std::max(dst.bounds.maxX, src.bounds.maxX);
+        dst.bounds.maxY = std::max(dst.bounds.maxY, src.bounds.maxY);
+        if(src.head >= 0) {
+            if(dst.head >= 0) {
+                mNext[dst.tail] = src.head;
+            } else {
+                dst.head = src.head;
+            }
+            dst.tail = src.tail;
+        }
+        dst.count += src.count;
+        return root;
+    }
+    void addPoint(int root, int x, int y) {
+        auto index = static_cast<int>(mPoints.size());
+        mPoints.emplace_back(static_cast<float>(x), static_cast<float>(y));
+        mNext.push_back(-1);
+        auto& data = mLabels[root];
+        if(data.head >= 0) {
+            mNext[data.tail] = index;
+        } else {
+            data.head = index;
+        }
+        data.tail = index;
+        ++data.count;
+        data.bounds.minX = std::min(data.bounds.minX, x);
+        data.bounds.minY = std::min(data.bounds.minY, y);
+        data.bounds.maxX = std::max(data.bounds.maxX, x);
+        data.bounds.maxY = std::max(data.bounds.maxY, y);
+    }
+    camcalib::EdgeComponents collect() const {
+        camcalib::EdgeComponents result;
+        result.points.resize(mPoints.size());
+        for(size_t label = 1; label < mLabels.size(); label++) {
+            const auto& data = mLabels[label];
+            if(data.parent != static_cast<int>(label)) {
+                continue;
+            }
+            const auto& b = data.bounds;
+            result.rects.emplace_back(b.minX, b.minY, b.maxX - b.minX + 1, b.maxY - b.minY + 1);
+            auto dst = result.offsets.back();
+            for(auto index = data.head; index >= 0; index = mNext[index]) {
+                result.points[dst++] = mPoints[index];
+            }
+            result.offsets.push_back(dst);
+        }
+        return result;
+    }
+private:
+    struct Bounds {
+        int minX{std::numeric_limits<int>::max()};
+        int minY{std::numeric_limits<int>::max()};
+        int maxX{std::numeric_limits<int>::min()};
+        int maxY{std::numeric_limits<int>::min()};
+    };
+    struct LabelData {
+        int parent{0};
+        Bounds bounds;
+        int head{-1};
+        int tail{-1};
+        int count{0};
+    };
+    std::vector<LabelData> mLabels;
+    // Точки всех меток и односвязные списки точек по меткам
+    std::vector<cv::Point2f> mPoints;
+    std::vector<int> mNext;
+};
+
+}
+
+namespace camcalib {
+
+EdgeComponents labelEdgeComponents(const cv::Mat &edges) {
+    CV_Assert(edges.type() == CV_8U);
+    ProvisionalLabels labels;
+    // Строки меток с полем в один пиксел слева и справа
+    std::vector<int> previous(edges.cols + 2, 0);
+    std::vector<int> current(edges.cols + 2, 0);
+    for(int y = 0; y < edges.rows; y++) {
+        std::swap(previous, current);
+        std::fill(current.begin(), current.end(), 0);
+        const auto* row = edges.ptr<uchar>(y);
+        for(int x = 0; x < edges.cols; x++) {
+            if(row[x] == 0) {
+                continue;
+            }
+            // Соседи: слева и три пиксела предыдущей строки
+            auto root = 0;
+            for(auto neighbour: {current[x], previous[x], previous[x + 1], previous[x + 2]}) {
+                if(neighbour == 0) {
+                    continue;
+                }
+                root = root == 0 ? labels.find(neighbour) : labels.unite(root, neighbour);
+            }
+            if(root == 0) {
+                root = labels.create();
+            }
+            current[x + 1] = root;
+            labels.addPoint(root, x, y);
+        }
+    }
+    return labels.collect();
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace camcalib {
+
+struct EdgeComponent {
+    cv::Rect rect;
+    // Точки краев компоненты, CV_32FC2, без копирования из EdgeComponents
+    cv::Mat points;
+};
+
+// Компоненты связности краев с точками, сгруппированными по компонентам
+struct EdgeComponents {
+    std::vector<cv::Rect> rects;
+    // Точки компоненты i - points[offsets[i]] ... points[offsets[i + 1] - 1]
+    std::vector<int> offsets{0};
+    std::vector<cv::Point2f> points;
+
+    size_t size() const {
+        return rects.size();
+    }
+    EdgeComponent operator[](size_t index) const {
+        auto count = offsets[index + 1] - offsets[index];
+        auto data = const_cast<cv::Point2f*>(points.data() + offsets[index]);
+        return EdgeComponent{rects[index], cv::Mat(count, 1, CV_32FC2, data)};
+    }
+};
+
+// Разметка 8-связных компонент ненулевых пикселов CV_8U за один проход.
+// Хранит только две строки меток и точки краев, без изображения меток.
+EdgeComponents labelEdgeComponents(const cv::Mat& edges);
+
+}
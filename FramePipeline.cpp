@@ -0,0 +1,132 @@
+#include "FramePipeline.h"
+#include <iostream>
+
+namespace camcalib {
+
+// Пауза потока поиска при пустом буфере кадров
+constexpr auto IdleInterval = std::chrono::milliseconds(1);
+
+template<typename Duration>
+static inline int64_t toNanoseconds(Duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+static inline double toMilliseconds(int64_t nanoseconds) {
+    return nanoseconds * 1e-6;
+}
+
+FramePipeline::FramePipeline(std::unique_ptr<FrameSource> source, Detector detector, size_t bufferSize)
+    : mSource{std::move(source)},
+    mDetector{std::move(detector)},
+    mFrames{bufferSize},
+    mResults{bufferSize} {
+    assert(mSource != nullptr);
+    assert(mDetector);
+}
+
+FramePipeline::~FramePipeline() {
+    stop();
+}
+
+void FramePipeline::start() {
+    if(mCaptureThread.joinable() || mDetectionThread.joinable()) {
+        return;
+    }
+    mStopRequested = false;
+    mCaptureFinished = false;
+    mDetectionFinished = false;
+    mDetectionThread = std::thread([this]{ detectionLoop(); });
+    mCaptureThread = std::thread([this]{ captureLoop(); });
+}
+
+void FramePipeline::stop() {
+    mStopRequested = true;
+    if(mCaptureThread.joinable()) {
+        mCaptureThread.join();
+    }
+    if(mDetectionThread.joinable()) {
+        mDetectionThread.join();
+    }
+}
+
+bool FramePipeline::isRunning() const {
+    return !mDetectionFinished;
+}
+
+std::optional<FrameResult> FramePipeline::takeLatestResult() {
+    std::optional<FrameResult> latest;
+    while(auto result = mResults.pop()) {
+        if(latest) {
+            ++mDroppedResults;
+        }
+        latest = std::move(result);
+    }
+    return latest;
+}
+
+PipelineStatistics FramePipeline::getStatistics() const {
+    PipelineStatistics stats;
+    stats.captured = mCaptured;
+    stats.droppedFrames = mDroppedFrames;
+    stats.processed = mProcessed;
+    stats.droppedResults = mDroppedResults;
+    if(stats.captured > 0) {
+        stats.captureTime = toMilliseconds(mCaptureTimeSum) / stats.captured;
+    }
+    if(stats.processed > 0) {
+        stats.detectionTime = toMilliseconds(mDetectionTimeSum) / stats.processed;
+        stats.latency = toMilliseconds(mLatencySum) / stats.processed;
+    }
+    return stats;
+}
+
+void FramePipeline::captureLoop() {
+    uint64_t index = 0;
+    while(!mStopRequested) {
+        auto start = std::chrono::steady_clock::now();
+        auto image = mSource->grab();
+        if(!image) {
+            break;
+        }
+        auto captureTime = std::chrono::steady_clock::now() - start;
+        ++mCaptured;
+        mCaptureTimeSum += toNanoseconds(captureTime);
+        // Если поиск не успевает, новый кадр отбрасывается, а не ждет в очереди
+        if(!mFrames.push({index++, std::move(*image), start, captureTime})) {
+            ++mDroppedFrames;
+        }
+    }
+    mCaptureFinished = true;
+}
+
+void FramePipeline::detectionLoop() {
+    while(!mStopRequested) {
+        auto frame = mFrames.pop();
+        if(!frame) {
+            if(mCaptureFinished && mFrames.empty()) {
+                break;
+            }
+            std::this_thread::sleep_for(IdleInterval);
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto circles = mDetector(frame->image);
+        auto end = std::chrono::steady_clock::now();
+        FrameResult result;
+        result.index = frame->index;
+        result.image = std::move(frame->image);
+        result.circles = std::move(circles);
+        result.captureTime = toMilliseconds(toNanoseconds(frame->captureTime));
+        result.detectionTime = toMilliseconds(toNanoseconds(end - start));
+        result.latency = toMilliseconds(toNanoseconds(end - frame->start));
+        ++mProcessed;
+        mDetectionTimeSum += toNanoseconds(end - start);
+        mLatencySum += toNanoseconds(end - frame->start);
+        if(!mResults.push(std::move(result))) {
+            ++mDroppedResults;
+        }
+    }
+    mDetectionFinished = true;
+}
+
+}
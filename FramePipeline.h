@@ -0,0 +1,84 @@
+#pragma once
+
+#include "FrameSource.h"
+#include "RingBuffer.h"
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace camcalib {
+
+struct FrameResult {
+    uint64_t index{};
+    cv::Mat image;
+    std::vector<cv::Vec3f> circles;
+    // Время этапов кадра, мс
+    double captureTime{};
+    double detectionTime{};
+    // От начала захвата до готовности результата
+    double latency{};
+};
+
+struct PipelineStatistics {
+    uint64_t captured{};
+    // Кадры, не поместившиеся в буфер, пока детектор был занят
+    uint64_t droppedFrames{};
+    uint64_t processed{};
+    // Результаты, замененные более новыми до того, как их забрали
+    uint64_t droppedResults{};
+    // Средние по обработанным кадрам, мс
+    double captureTime{};
+    double detectionTime{};
+    double latency{};
+};
+
+// Конвейер: поток захвата -> кольцевой буфер -> поток поиска -> кольцевой буфер результатов.
+// Захват, поиск и отображение выполняются одновременно, при перегрузке кадры отбрасываются.
+class FramePipeline {
+public:
+    // Вызывается только из потока поиска, может хранить состояние (например, GridTracker)
+    using Detector = std::function<std::vector<cv::Vec3f>(const cv::Mat&)>;
+    FramePipeline(std::unique_ptr<FrameSource> source, Detector detector, size_t bufferSize = 4);
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+    ~FramePipeline();
+    void start();
+    void stop();
+    // Поток захвата работает, пока источник выдает кадры
+    bool isRunning() const;
+    // Самый свежий результат для отображения, nullopt - новых нет
+    std::optional<FrameResult> takeLatestResult();
+    PipelineStatistics getStatistics() const;
+private:
+    struct CapturedFrame {
+        uint64_t index{};
+        cv::Mat image;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::duration captureTime{};
+    };
+    void captureLoop();
+    void detectionLoop();
+    std::unique_ptr<FrameSource> mSource;
+    Detector mDetector;
+    RingBuffer<CapturedFrame> mFrames;
+    RingBuffer<FrameResult> mResults;
+    std::thread mCaptureThread;
+    std::thread mDetectionThread;
+    std::atomic<bool> mStopRequested{false};
+    std::atomic<bool> mCaptureFinished{true};
+    std::atomic<bool> mDetectionFinished{true};
+    std::atomic<uint64_t> mCaptured{0};
+    std::atomic<uint64_t> mDroppedFrames{0};
+    std::atomic<uint64_t> mProcessed{0};
+    std::atomic<uint64_t> mDroppedResults{0};
+    // Суммы длительностей в наносекундах
+    std::atomic<int64_t> mCaptureTimeSum{0};
+    std::atomic<int64_t> mDetectionTimeSum{0};
+    std::atomic<int64_t> mLatencySum{0};
+};
+
+}
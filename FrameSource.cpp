@@ -0,0 +1,71 @@
+#include "FrameSource.h"
+#include "MappedImage.h"
+#include <opencv2/imgproc.hpp>
+#include <iostream>
+#include <thread>
+
+namespace camcalib {
+
+DirectoryFrameSource::DirectoryFrameSource(std::vector<std::string> files, double fps, bool loop)
+    : mFiles{std::move(files)}, mLoop{loop} {
+    if(fps > 0.0) {
+        mInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / fps));
+    }
+}
+
+std::optional<cv::Mat> DirectoryFrameSource::grab() {
+    // Файлы, которые не удалось прочитать, пропускаются, но не более одного круга подряд
+    for(size_t attempt = 0; attempt < mFiles.size(); attempt++) {
+        if(mNext == mFiles.size()) {
+            if(!mLoop) {
+                return std::nullopt;
+            }
+            mNext = 0;
+        }
+        const auto& filename = mFiles[mNext++];
+        auto image = readGrayscaleImage(filename);
+        if(image.empty()) {
+            std::cerr << __FUNCTION__": can't read " << filename << std::endl;
+            continue;
+        }
+        waitForNextFrame();
+        return image;
+    }
+    return std::nullopt;
+}
+
+void DirectoryFrameSource::waitForNextFrame() {
+    if(mInterval == std::chrono::steady_clock::duration::zero()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if(mNextTime > now) {
+        std::this_thread::sleep_until(mNextTime);
+        mNextTime += mInterval;
+    } else {
+        mNextTime = now + mInterval;
+    }
+}
+
+VideoFrameSource::VideoFrameSource(const std::string &filename)
+    : mCapture{filename} {
+    if(!mCapture.isOpened()) {
+        std::cerr << __FUNCTION__": can't open " << filename << std::endl;
+    }
+}
+
+std::optional<cv::Mat> VideoFrameSource::grab() {
+    cv::Mat frame;
+    if(!mCapture.isOpened() || !mCapture.read(frame) || frame.empty()) {
+        return std::nullopt;
+    }
+    if(frame.channels() == 1) {
+        return frame;
+    }
+    cv::Mat gray;
+    cv::cvtColor(frame, gray, frame.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace camcalib {
+
+// Источник полутоновых кадров: драйвер камеры или воспроизведение записанных кадров.
+// grab вызывается из одного потока и должен возвращаться за ограниченное время,
+// чтобы конвейер мог остановиться.
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+    // nullopt - кадров больше нет
+    virtual std::optional<cv::Mat> grab() = 0;
+};
+
+// Воспроизведение файлов изображений с заданной частотой кадров
+class DirectoryFrameSource : public FrameSource {
+public:
+    // fps <= 0 - кадры выдаются без задержки
+    DirectoryFrameSource(std::vector<std::string> files, double fps, bool loop);
+    std::optional<cv::Mat> grab() override;
+private:
+    void waitForNextFrame();
+    std::vector<std::string> mFiles;
+    size_t mNext{0};
+    std::chrono::steady_clock::duration mInterval{};
+    std::chrono::steady_clock::time_point mNextTime{};
+    bool mLoop;
+};
+
+// Воспроизведение видеофайла, цветные кадры преобразуются в полутоновые
+class VideoFrameSource : public FrameSource {
+public:
+    explicit VideoFrameSource(const std::string& filename);
+    bool isOpened() const {
+        return mCapture.isOpened();
+    }
+    std::optional<cv::Mat> grab() override;
+private:
+    cv::VideoCapture mCapture;
+};
+
+}
@@ -0,0 +1,371 @@
+#include "Calibration.h"
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Очередь декодированных кадров ограниченного размера:
+// читатели блокируются, пока накопитель не заберет кадр или не закроет очередь
+class FrameQueue {
+public:
+    FrameQueue(size_t capacity, int producers)
+        : mCapacity{std::max<size_t>(capacity, 1)}, mProducers{producers} {
+    }
+    // false - очередь закрыта, кадр не нужен
+    bool push(cv::Mat frame) {
+        std::unique_lock lock(mMutex);
+        mNotFull.wait(lock, [this]{ return mFrames.size() < mCapacity || mClosed; });
+        if(mClosed) {
+            return false;
+        }
+        mFrames.push_back(std::move(frame));
+        mNotEmpty.notify_one();
+        return true;
+    }
+    // Прекращает прием кадров: ожидающие читатели освобождаются
+    void close() {
+        std::lock_guard lock(mMutex);
+        mClosed = true;
+        mFrames.clear();
+        mNotFull.notify_all();
+        mNotEmpty.notify_all();
+    }
+    std::optional<cv::Mat> pop() {
+        std::unique_lock lock(mMutex);
+        mNotEmpty.wait(lock, [this]{ return !mFrames.empty() || mProducers == 0 || mClosed; });
+        if(mFrames.empty()) {
+            return std::nullopt;
+        }
+        auto frame = std::move(mFrames.front());
+        mFrames.pop_front();
+        mNotFull.notify_one();
+        return frame;
+    }
+    void finishProducer() {
+        std::lock_guard lock(mMutex);
+        --mProducers;
+        mNotEmpty.notify_all();
+    }
+private:
+    std::mutex mMutex;
+    std::condition_variable mNotFull;
+    std::condition_variable mNotEmpty;
+    std::deque<cv::Mat> mFrames;
+    size_t mCapacity;
+    int mProducers;
+    bool mClosed{false};
+};
+
+// Закрывает очередь и дожидается читателей при любом выходе из streamFrames,
+// в т.ч. по исключению consume
+class ReaderThreads {
+public:
+    explicit ReaderThreads(FrameQueue& queue)
+        : mQueue{queue} {
+    }
+    ~ReaderThreads() {
+        mQueue.close();
+        for(auto& thread: mThreads) {
+            thread.join();
+        }
+    }
+    template<typename Callable>
+    void start(Callable reader) {
+        mThreads.emplace_back(std::move(reader));
+    }
+private:
+    FrameQueue& mQueue;
+    std::vector<std::thread> mThreads;
+};
+
+// Декодирует файлы пулом потоков и передает кадры consume в вызывающем потоке.
+// Порядок кадров не сохраняется - для накопления он не важен.
+template<typename Callable>
+void streamFrames(const std::vector<std::string>& files,
+                  const camcalib::StackingParams& params,
+                  Callable consume) {
+    auto readers = std::clamp(params.readerThreads, 1, static_cast<int>(files.size()));
+    FrameQueue queue(params.queueSize, readers);
+    std::atomic<size_t> next{0};
+    // Первое исключение читателя передается вызывающему потоку
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    {
+        ReaderThreads threads(queue);
+        for(int i = 0; i < readers; i++) {
+            threads.start([&]{
+                try {
+                    for(auto index = next++; index < files.size(); index = next++) {
+                        auto frame = cv::imread(files[index], cv::IMREAD_GRAYSCALE | cv::IMREAD_ANYDEPTH);
+                        if(frame.empty()) {
+                            std::cerr << __FUNCTION__": can't read " << files[index] << std::endl;
+                            continue;
+                        }
+                        if(!queue.push(std::move(frame))) {
+                            break;
+                        }
+                    }
+                } catch(...) {
+                    std::lock_guard lock(errorMutex);
+                    if(!error) {
+                        error = std::current_exception();
+                    }
+                    queue.close();
+                }
+                queue.finishProducer();
+            });
+        }
+        while(auto frame = queue.pop()) {
+            consume(*frame);
+        }
+    }
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Накопление ведется по полосам фиксированной высоты параллельно
+constexpr auto TileRows = 64;
+
+template<typename Kernel>
+void forEachRow(int rows, Kernel kernel) {
+    auto tiles = (rows + TileRows - 1) / TileRows;
+    cv::parallel_for_(cv::Range(0, tiles), [&](const cv::Range& range) {
+        for(int tile = range.start; tile < range.end; tile++) {
+            auto last = std::min(rows, (tile + 1) * TileRows);
+            for(int row = tile * TileRows; row < last; row++) {
+                kernel(row);
+            }
+        }
+    });
+}
+
+void addRow(const uchar* src, int32_t* acc, int width) {
+    int x = 0;
+#if CV_SIMD128
+    for(; x <= width - 16; x += 16) {
+        cv::v_uint16x8 lo, hi;
+        cv::v_expand(cv::v_load(src + x), lo, hi);
+        cv::v_uint32x4 a, b, c, d;
+        cv::v_expand(lo, a, b);
+        cv::v_expand(hi, c, d);
+        cv::v_store(acc + x, cv::v_load(acc + x) + cv::v_reinterpret_as_s32(a));
+        cv::v_store(acc + x + 4, cv::v_load(acc + x + 4) + cv::v_reinterpret_as_s32(b));
+        cv::v_store(acc + x + 8, cv::v_load(acc + x + 8) + cv::v_reinterpret_as_s32(c));
+        cv::v_store(acc + x + 12, cv::v_load(acc + x + 12) + cv::v_reinterpret_as_s32(d));
+    }
+#endif
+    for(; x < width; x++) {
+        acc[x] += src[x];
+    }
+}
+
+void addRow(const ushort* src, int32_t* acc, int width) {
+    int x = 0;
+#if CV_SIMD128
+    for(; x <= width - 8; x += 8) {
+        cv::v_uint32x4 a, b;
+        cv::v_expand(cv::v_load(src + x), a, b);
+        cv::v_store(acc + x, cv::v_load(acc + x) + cv::v_reinterpret_as_s32(a));
+        cv::v_store(acc + x + 4, cv::v_load(acc + x + 4) + cv::v_reinterpret_as_s32(b));
+    }
+#endif
+    for(; x < width; x++) {
+        acc[x] += src[x];
+    }
+}
+
+// Однопроходная оценка среднего и дисперсии (Welford)
+void updateMomentsRow(const float* src, float* mean, float* m2, float invCount, int width) {
+    int x = 0;
+#if CV_SIMD128
+    auto vInvCount = cv::v_setall_f32(invCount);
+    for(; x <= width - 4; x += 4) {
+        auto value = cv::v_load(src + x);
+        auto vMean = cv::v_load(mean + x);
+        auto delta = value - vMean;
+        vMean = vMean + delta * vInvCount;
+        cv::v_store(mean + x, vMean);
+        cv::v_store(m2 + x, cv::v_load(m2 + x) + delta * (value - vMean));
+    }
+#endif
+    for(; x < width; x++) {
+        auto delta = src[x] - mean[x];
+        mean[x] += delta * invCount;
+        m2[x] += delta * (src[x] - mean[x]);
+    }
+}
+
+void addClippedRow(const float* src, const float* mean, const float* threshold2,
+                   float* sum, float* count, int width) {
+    int x = 0;
+#if CV_SIMD128
+    auto zero = cv::v_setzero_f32();
+    auto one = cv::v_setall_f32(1.0f);
+    for(; x <= width - 4; x += 4) {
+        auto value = cv::v_load(src + x);
+        auto delta = value - cv::v_load(mean + x);
+        auto inlier = (delta * delta) <= cv::v_load(threshold2 + x);
+        cv::v_store(sum + x, cv::v_load(sum + x) + cv::v_select(inlier, value, zero));
+        cv::v_store(count + x, cv::v_load(count + x) + cv::v_select(inlier, one, zero));
+    }
+#endif
+    for(; x < width; x++) {
+        auto delta = src[x] - mean[x];
+        if(delta * delta <= threshold2[x]) {
+            sum[x] += src[x];
+            count[x] += 1.0f;
+        }
+    }
+}
+
+void divideClippedRow(const float* sum, const float* count, const float* mean, float* dst, int width) {
+    int x = 0;
+#if CV_SIMD128
+    auto zero = cv::v_setzero_f32();
+    for(; x <= width - 4; x += 4) {
+        auto vCount = cv::v_load(count + x);
+        auto average = cv::v_load(sum + x) / vCount;
+        cv::v_store(dst + x, cv::v_select(vCount > zero, average, cv::v_load(mean + x)));
+    }
+#endif
+    for(; x < width; x++) {
+        dst[x] = count[x] > 0.0f ? sum[x] / count[x] : mean[x];
+    }
+}
+
+bool isCompatibleFrame(const cv::Mat& frame, const cv::Mat& first) {
+    if(frame.size() != first.size() || frame.type() != first.type()) {
+        std::cerr << __FUNCTION__": frame " << frame.size() << " type " << frame.type()
+                  << " differs from " << first.size() << " type " << first.type() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+cv::Mat accumulateMean(const std::vector<std::string>& files, const camcalib::StackingParams& params) {
+    cv::Mat sum;
+    int depth = -1;
+    int frames = 0;
+    streamFrames(files, params, [&](const cv::Mat& frame) {
+        if(sum.empty()) {
+            if(frame.depth() != CV_8U && frame.depth() != CV_16U) {
+                std::cerr << __FUNCTION__": unsupported image depth " << frame.depth() << std::endl;
+                return;
+            }
+            depth = frame.depth();
+            sum = cv::Mat::zeros(frame.size(), CV_32S);
+        } else if(frame.depth() != depth || frame.size() != sum.size()) {
+            std::cerr << __FUNCTION__": frame " << frame.size() << " differs from " << sum.size() << std::endl;
+            return;
+        }
+        // Сумма 16-битных кадров в int32 точна до 32768 кадров
+        if(depth == CV_16U && frames == 32768) {
+            std::cerr << __FUNCTION__": too many 16-bit frames, the rest are skipped" << std::endl;
+            return;
+        }
+        forEachRow(frame.rows, [&](int row) {
+            if(depth == CV_8U) {
+                addRow(frame.ptr<uchar>(row), sum.ptr<int32_t>(row), frame.cols);
+            } else {
+                addRow(frame.ptr<ushort>(row), sum.ptr<int32_t>(row), frame.cols);
+            }
+        });
+        ++frames;
+    });
+    if(frames == 0) {
+        return {};
+    }
+    cv::Mat result;
+    sum.convertTo(result, depth, 1.0 / frames);
+    return result;
+}
+
+cv::Mat accumulateSigmaClipped(const std::vector<std::string>& files, const camcalib::StackingParams& params) {
+    // Первый проход - среднее и дисперсия, второй - среднее по значениям в пределах порога.
+    // Файлы декодируются дважды, зато память не зависит от числа кадров.
+    cv::Mat first, floatFrame, mean, m2;
+    int frames = 0;
+    streamFrames(files, params, [&](const cv::Mat& frame) {
+        if(first.empty()) {
+            if(frame.depth() != CV_8U && frame.depth() != CV_16U) {
+                std::cerr << __FUNCTION__": unsupported image depth " << frame.depth() << std::endl;
+                return;
+            }
+            first = frame;
+            mean = cv::Mat::zeros(frame.size(), CV_32F);
+            m2 = cv::Mat::zeros(frame.size(), CV_32F);
+        } else if(!isCompatibleFrame(frame, first)) {
+            return;
+        }
+        frame.convertTo(floatFrame, CV_32F);
+        auto invCount = 1.0f / static_cast<float>(++frames);
+        forEachRow(frame.rows, [&](int row) {
+            updateMomentsRow(floatFrame.ptr<float>(row), mean.ptr<float>(row), m2.ptr<float>(row),
+                             invCount, frame.cols);
+        });
+    });
+    if(frames == 0) {
+        return {};
+    }
+    auto depth = first.depth();
+    first.release();
+    if(frames < 3) {
+        cv::Mat result;
+        mean.convertTo(result, depth);
+        return result;
+    }
+    // m2 -> квадрат порога отсечения
+    auto& threshold2 = m2;
+    threshold2 *= params.clipSigma * params.clipSigma / frames;
+    cv::Mat sum = cv::Mat::zeros(mean.size(), CV_32F);
+    cv::Mat count = cv::Mat::zeros(mean.size(), CV_32F);
+    streamFrames(files, params, [&](const cv::Mat& frame) {
+        if(frame.size() != mean.size() || frame.depth() != depth) {
+            return;
+        }
+        frame.convertTo(floatFrame, CV_32F);
+        forEachRow(frame.rows, [&](int row) {
+            addClippedRow(floatFrame.ptr<float>(row), mean.ptr<float>(row), threshold2.ptr<float>(row),
+                          sum.ptr<float>(row), count.ptr<float>(row), frame.cols);
+        });
+    });
+    forEachRow(sum.rows, [&](int row) {
+        divideClippedRow(sum.ptr<float>(row), count.ptr<float>(row), mean.ptr<float>(row),
+                         sum.ptr<float>(row), sum.cols);
+    });
+    cv::Mat result;
+    sum.convertTo(result, depth);
+    return result;
+}
+
+}
+
+namespace camcalib {
+
+cv::Mat accumulateImageFromFiles(const std::vector<std::string> &files) {
+    return accumulateImageFromFiles(files, StackingParams{});
+}
+
+cv::Mat accumulateImageFromFiles(const std::vector<std::string> &files, const StackingParams &params) {
+    if(files.empty()) {
+        return {};
+    }
+    switch(params.mode) {
+    case StackingMode::Mean:
+        return accumulateMean(files, params);
+    case StackingMode::SigmaClipped:
+        return accumulateSigmaClipped(files, params);
+    }
+    return {};
+}
+
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <QPainter>
+#include <QPainterPath>
+#include <cmath>
+#include <optional>
+#include <vector>
 #include <opencv2/core.hpp>
 
 class Graphics {
@@ -10,41 +14,54 @@ public:
     Graphics(QPainter& painter,
              const QRectF& dstRect,
              const QRectF& srcRect)
+        : Graphics(painter, dstRect, srcRect, dstRect) {
+    }
+    // exposedRect - перерисовываемая часть dstRect, рисование за ее пределами отсекается
+    Graphics(QPainter& painter,
+             const QRectF& dstRect,
+             const QRectF& srcRect,
+             const QRectF& exposedRect)
         : mPainter{painter} {
         mPainter.save();
-        setFitInViewTransform(dstRect, srcRect);
+        mPainter.setClipRect(exposedRect);
+        mPainter.setWorldTransform(makeFitInViewTransform(dstRect, srcRect), true);
+        mVisibleRect = mPainter.worldTransform().inverted().mapRect(exposedRect);
     }
     ~Graphics() {
         mPainter.restore();
     }
 
-    void drawImage(const cv::Mat& image) const {
-        auto qimage = QImage((uchar*)image.data,
-                             image.cols,
-                             image.rows,
-                             QImage::Format_Grayscale8);
-        mPainter.drawImage(qimage.rect(), qimage);
+    // target - прямоугольник изображения полного разрешения, pixmap может быть уменьшенной копией
+    void drawImage(const QPixmap& pixmap, const QRectF& target) const {
+        mPainter.setRenderHint(QPainter::SmoothPixmapTransform, pixmap.width() < target.width());
+        mPainter.drawPixmap(target, pixmap, QRectF(pixmap.rect()));
+    }
+
+    // Пикселов экрана на пиксел изображения
+    double getScale() const {
+        auto transform = mPainter.worldTransform();
+        return std::hypot(transform.m11(), transform.m12());
+    }
+
+    // Видимая часть в координатах изображения
+    const QRectF& getVisibleRect() const {
+        return mVisibleRect;
     }
 
-    void drawGridPoints(const std::vector<cv::Point2f>& grid) const {
-        constexpr auto size = 10.0;
+    void drawCrosses(const QVector<QLineF>& lines) const {
         mPainter.setPen(makeCosmeticPen(Qt::cyan, 1));
-        for(const auto& gridPoint: grid) {
-            auto cross = std::array{QLineF(gridPoint.x - size, gridPoint.y,
-                                           gridPoint.x + size, gridPoint.y),
-                                    QLineF(gridPoint.x, gridPoint.y - size,
-                                           gridPoint.x, gridPoint.y + size)};
-            mPainter.drawLines(cross.data(), (int)cross.size());
-        }
+        mPainter.drawLines(lines);
     }
 
-    void drawCircle(const cv::Vec3f& circle) {
+    void drawCircles(const QPainterPath& circles) const {
         mPainter.setPen(makeCosmeticPen(Qt::green, 1));
-        auto circleRect = QRectF{circle[0] - circle[2],
-                                 circle[1] - circle[2],
-                                 2.0 * circle[2],
-                                 2.0 * circle[2]};
-        mPainter.drawEllipse(circleRect);
+        mPainter.drawPath(circles);
+    }
+
+    // Рамки компонент краев, кандидатов в метки
+    void drawCandidates(const QPainterPath& rects) const {
+        mPainter.setPen(makeCosmeticPen(Qt::yellow, 1));
+        mPainter.drawPath(rects);
     }
 
     void drawImageROI(const cv::Rect& roi) const {
@@ -52,18 +69,52 @@ public:
         mPainter.drawRect(QRectF(roi.x, roi.y, roi.width, roi.height));
     }
 
+    void drawExcludedRegion(const cv::Rect& region) const {
+        mPainter.setPen(makeCosmeticPen(Qt::red, 2));
+        mPainter.setBrush(QBrush(Qt::red, Qt::BDiagPattern));
+        mPainter.drawRect(QRectF(region.x, region.y, region.width, region.height));
+        mPainter.setBrush(Qt::NoBrush);
+    }
+
+    // Изображение srcRect вписывается в центр dstRect с сохранением пропорций
+    static QTransform makeFitInViewTransform(const QRectF& dstRect, const QRectF& srcRect) {
+        auto scale = std::min(dstRect.width() / srcRect.width(), dstRect.height() / srcRect.height());
+        auto transform = QTransform{};
+        transform.translate(dstRect.center().x(), dstRect.center().y());
+        transform.scale(scale, scale);
+        transform.translate(-srcRect.center().x(), -srcRect.center().y());
+        return transform;
+    }
+
+    // Рамки drawImageROI и drawExcludedRegion в координатах изображения
+    static QRectF regionsBounds(const std::optional<cv::Rect>& roi, const std::vector<cv::Rect>& regions) {
+        auto bounds = QRectF{};
+        if(roi) {
+            bounds |= QRectF(roi->x, roi->y, roi->width, roi->height);
+        }
+        for(const auto& region: regions) {
+            bounds |= QRectF(region.x, region.y, region.width, region.height);
+        }
+        return bounds;
+    }
+
+    // Прямоугольник изображения в координатах dstRect с запасом на толщину пера
+    static QRect mapToView(const QRectF& dstRect, const QRectF& srcRect, const QRectF& rect) {
+        if(rect.isNull()) {
+            return {};
+        }
+        constexpr auto penMargin = 3;
+        return makeFitInViewTransform(dstRect, srcRect).mapRect(rect).toAlignedRect()
+            .adjusted(-penMargin, -penMargin, penMargin, penMargin);
+    }
+
 private:
     static QPen makeCosmeticPen(QColor color, qreal width) {
         auto pen = QPen(color, width);
         pen.setCosmetic(true);
         return pen;
     }
-    void setFitInViewTransform(const QRectF& dstRect, const QRectF& srcRect) const {
-        auto scale = std::min(dstRect.width() / srcRect.width(), dstRect.height() / srcRect.height());
-        mPainter.translate(dstRect.center());
-        mPainter.scale(scale, scale);
-        mPainter.translate(-srcRect.center());
-    }
     QPainter& mPainter;
+    QRectF mVisibleRect;
 };
 
@@ -0,0 +1,244 @@
+#include "GridIndexing.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+// Равномерная сетка ячеек над точками для поиска соседей за O(1)
+class SpatialHash {
+public:
+    SpatialHash(const std::vector<cv::Point2f>& points, float cellSize)
+        : mPoints{points}, mCellSize{cellSize} {
+        auto [minX, maxX] = std::minmax_element(points.begin(), points.end(), [](const auto& p1, const auto& p2){
+            return p1.x < p2.x;
+        });
+        auto [minY, maxY] = std::minmax_element(points.begin(), points.end(), [](const auto& p1, const auto& p2){
+            return p1.y < p2.y;
+        });
+        mOrigin = cv::Point2f(minX->x, minY->y);
+        auto width = maxX->x - minX->x;
+        auto height = maxY->y - minY->y;
+        // Далекие выбросы не должны раздувать число ячеек
+        const auto maxCells = 4.0 * points.size() + 16.0;
+        while((width / mCellSize + 1.0) * (height / mCellSize + 1.0) > maxCells) {
+            mCellSize *= 2.0f;
+        }
+        mCols = static_cast<int>(width / mCellSize) + 1;
+        mRows = static_cast<int>(height / mCellSize) + 1;
+        mCellStart.assign(mCols * mRows + 1, 0);
+        for(const auto& p: points) {
+            ++mCellStart[cellIndex(p) + 1];
+        }
+        std::partial_sum(mCellStart.begin(), mCellStart.end(), mCellStart.begin());
+        mIndices.resize(points.size());
+        auto fill = mCellStart;
+        for(size_t i = 0; i < points.size(); i++) {
+            mIndices[fill[cellIndex(points[i])]++] = static_cast<int>(i);
+        }
+    }
+    float cellSize() const {
+        return mCellSize;
+    }
+    template<typename Callable>
+    void forEachNear(const cv::Point2f& pos, float radius, Callable callable) const {
+        auto cells = static_cast<int>(std::ceil(radius / mCellSize));
+        auto cx = cellX(pos.x);
+        auto cy = cellY(pos.y);
+        auto radius2 = radius * radius;
+        for(int y = std::max(0, cy - cells); y <= std::min(mRows - 1, cy + cells); y++) {
+            for(int x = std::max(0, cx - cells); x <= std::min(mCols - 1, cx + cells); x++) {
+                auto cell = y * mCols + x;
+                for(auto k = mCellStart[cell]; k < mCellStart[cell + 1]; k++) {
+                    auto index = mIndices[k];
+                    auto d = mPoints[index] - pos;
+                    if(d.dot(d) <= radius2) {
+                        callable(index);
+                    }
+                }
+            }
+        }
+    }
+private:
+    int cellX(float x) const {
+        return std::clamp(static_cast<int>((x - mOrigin.x) / mCellSize), 0, mCols - 1);
+    }
+    int cellY(float y) const {
+        return std::clamp(static_cast<int>((y - mOrigin.y) / mCellSize), 0, mRows - 1);
+    }
+    int cellIndex(const cv::Point2f& p) const {
+        return cellY(p.y) * mCols + cellX(p.x);
+    }
+    const std::vector<cv::Point2f>& mPoints;
+    cv::Point2f mOrigin;
+    float mCellSize;
+    int mCols{};
+    int mRows{};
+    std::vector<int> mCellStart;
+    std::vector<int> mIndices;
+};
+
+// Допустимое отклонение соседа от узла решетки в долях шага
+constexpr auto LatticeTolerance = 0.3;
+
+inline int64_t makeKey(const cv::Point& index) {
+    return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(index.x)) << 32)
+                                | static_cast<uint32_t>(index.y));
+}
+
+std::optional<float> estimateStep(const std::vector<cv::Point2f>& points, const SpatialHash& hash) {
+    std::vector<float> nearest;
+    nearest.reserve(points.size());
+    for(size_t i = 0; i < points.size(); i++) {
+        auto best = std::numeric_limits<float>::max();
+        hash.forEachNear(points[i], 2.0f * hash.cellSize(), [&](int j) {
+            if(j != static_cast<int>(i)) {
+                best = std::min(best, static_cast<float>(cv::norm(points[j] - points[i])));
+            }
+        });
+        if(best < std::numeric_limits<float>::max() && best > 0.0f) {
+            nearest.push_back(best);
+        }
+    }
+    if(nearest.empty()) {
+        return std::nullopt;
+    }
+    auto median = nearest.begin() + nearest.size() / 2;
+    std::nth_element(nearest.begin(), median, nearest.end());
+    return *median;
+}
+
+// Угол поворота решетки в диапазоне (-45, 45] градусов
+double estimateRotation(const std::vector<cv::Point2f>& points, const SpatialHash& hash, float step) {
+    auto sumCos = 0.0;
+    auto sumSin = 0.0;
+    for(size_t i = 0; i < points.size(); i++) {
+        hash.forEachNear(points[i], 1.25f * step, [&](int j) {
+            auto d = points[j] - points[i];
+            if(cv::norm(d) < 0.75 * step) {
+                return;
+            }
+            // Направления соседей совпадают с точностью до 90 градусов
+            auto angle = 4.0 * std::atan2(d.y, d.x);
+            sumCos += std::cos(angle);
+            sumSin += std::sin(angle);
+        });
+    }
+    return std::atan2(sumSin, sumCos) / 4.0;
+}
+
+// Начальная точка обхода - ближайшая к центру облака, у которой есть соседи по решетке,
+// чтобы обход не начался с выброса
+size_t findSeed(const std::vector<cv::Point2f>& points, const SpatialHash& hash, float step) {
+    auto center = std::accumulate(points.begin(), points.end(), cv::Point2f{}) / static_cast<float>(points.size());
+    auto seed = size_t{0};
+    auto bestDistance = std::numeric_limits<double>::max();
+    auto bestNeighbours = 0;
+    for(size_t i = 0; i < points.size(); i++) {
+        auto neighbours = 0;
+        hash.forEachNear(points[i], 1.25f * step, [&](int j) {
+            if(cv::norm(points[j] - points[i]) >= 0.75 * step) {
+                ++neighbours;
+            }
+        });
+        neighbours = std::min(neighbours, 2);
+        auto distance = cv::norm(points[i] - center);
+        if(neighbours > bestNeighbours || (neighbours == bestNeighbours && distance < bestDistance)) {
+            seed = i;
+            bestDistance = distance;
+            bestNeighbours = neighbours;
+        }
+    }
+    return seed;
+}
+
+}
+
+namespace camcalib {
+
+IndexedGrid indexGrid(const std::vector<cv::Point2f> &points) {
+    CAMCALIB_TRACE_SCOPE("indexGrid");
+    if(points.size() < 2) {
+        return {};
+    }
+    auto [minX, maxX] = std::minmax_element(points.begin(), points.end(), [](const auto& p1, const auto& p2){
+        return p1.x < p2.x;
+    });
+    auto [minY, maxY] = std::minmax_element(points.begin(), points.end(), [](const auto& p1, const auto& p2){
+        return p1.y < p2.y;
+    });
+    auto area = std::max(1.0f, (maxX->x - minX->x) * (maxY->y - minY->y));
+    SpatialHash hash(points, std::sqrt(area / points.size()));
+    auto step = estimateStep(points, hash);
+    if(!step) {
+        return {};
+    }
+    auto theta = estimateRotation(points, hash, *step);
+    auto u = cv::Point2d(std::cos(theta), std::sin(theta)) / *step;
+    auto v = cv::Point2d(-std::sin(theta), std::cos(theta)) / *step;
+    // Обход графа соседей в ширину: индекс соседа - индекс точки плюс единичный шаг решетки
+    std::vector<cv::Point> indices(points.size());
+    std::vector<bool> assigned(points.size(), false);
+    std::unordered_map<int64_t, int> occupied;
+    std::deque<int> queue;
+    auto seed = findSeed(points, hash, *step);
+    assigned[seed] = true;
+    occupied.emplace(makeKey({}), static_cast<int>(seed));
+    queue.push_back(static_cast<int>(seed));
+    while(!queue.empty()) {
+        auto i = queue.front();
+        queue.pop_front();
+        hash.forEachNear(points[i], 1.5f * *step, [&](int j) {
+            if(assigned[j]) {
+                return;
+            }
+            auto d = cv::Point2d(points[j] - points[i]);
+            auto a = d.dot(u);
+            auto b = d.dot(v);
+            auto ra = std::round(a);
+            auto rb = std::round(b);
+            if(std::abs(ra) + std::abs(rb) != 1.0
+                || std::abs(a - ra) > LatticeTolerance
+                || std::abs(b - rb) > LatticeTolerance) {
+                return;
+            }
+            auto index = indices[i] + cv::Point(static_cast<int>(ra), static_cast<int>(rb));
+            if(!occupied.emplace(makeKey(index), j).second) {
+                return;
+            }
+            assigned[j] = true;
+            indices[j] = index;
+            queue.push_back(j);
+        });
+    }
+    std::vector<int> order;
+    auto minIndex = cv::Point(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    for(size_t i = 0; i < points.size(); i++) {
+        if(assigned[i]) {
+            order.push_back(static_cast<int>(i));
+            minIndex.x = std::min(minIndex.x, indices[i].x);
+            minIndex.y = std::min(minIndex.y, indices[i].y);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&indices](int i1, int i2){
+        const auto& p1 = indices[i1];
+        const auto& p2 = indices[i2];
+        return std::tie(p1.y, p1.x) < std::tie(p2.y, p2.x);
+    });
+    IndexedGrid result;
+    result.centers.reserve(order.size());
+    result.indices.reserve(order.size());
+    for(auto i: order) {
+        result.centers.push_back(points[i]);
+        result.indices.push_back(indices[i] - minIndex);
+    }
+    return result;
+}
+
+}
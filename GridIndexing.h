@@ -0,0 +1,19 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace camcalib {
+
+struct IndexedGrid {
+    std::vector<cv::Point2f> centers;
+    // Номер узла (столбец, строка) для каждой точки centers, начиная с 0
+    std::vector<cv::Point> indices;
+};
+
+// Нумерация узлов сетки по графу ближайших соседей.
+// Допускает пропущенные и лишние точки и небольшой поворот сетки;
+// столбцы нумеруются вдоль x, строки вдоль y изображения.
+IndexedGrid indexGrid(const std::vector<cv::Point2f>& points);
+
+}
@@ -0,0 +1,119 @@
+#include "GridTracker.h"
+#include "Trace.h"
+#include <algorithm>
+#include <execution>
+#include <iostream>
+
+namespace camcalib {
+
+// Допустимые отклонения метки, найденной в окне, от предсказания
+constexpr auto MaxShiftInRadii = 0.5;
+constexpr auto MinRadiusRatio = 0.8f;
+constexpr auto MaxRadiusRatio = 1.25f;
+
+GridTracker::GridTracker(const TrackingParams &params)
+    : mParams{params} {
+    assert(!params.search.gridSize.empty());
+}
+
+const std::vector<cv::Vec3f> &GridTracker::track(const cv::Mat &image) {
+    CAMCALIB_TRACE_SCOPE("GridTracker::track");
+    mFullDetection = false;
+    // Окна 16-битного кадра переводятся в 8 бит одним диапазоном яркости
+    auto search = withIntensityRange(image, mParams.search);
+    if(!mCircles.empty() && refine(image, search)) {
+        return mCircles;
+    }
+    mFullDetection = true;
+    detect(image, search);
+    return mCircles;
+}
+
+void GridTracker::reset() {
+    mCircles.clear();
+    mVelocity = {};
+    mConfidence = 0.0;
+    mFullDetection = false;
+}
+
+std::vector<cv::Point2f> GridTracker::getCenters() const {
+    std::vector<cv::Point2f> centers(mCircles.size());
+    std::transform(mCircles.begin(), mCircles.end(), centers.begin(), [](const cv::Vec3f& circle){
+        return cv::Point2f(circle[0], circle[1]);
+    });
+    return centers;
+}
+
+bool GridTracker::refine(const cv::Mat &image, const GridSearchParams& search) {
+    std::vector<std::optional<cv::Vec3f>> fits(mCircles.size());
+    std::transform(std::execution::par,
+                   mCircles.begin(),
+                   mCircles.end(),
+                   fits.begin(),
+                   [this, &image, &search](const cv::Vec3f& circle) -> std::optional<cv::Vec3f> {
+                       auto predicted = cv::Point2f(circle[0], circle[1]) + mVelocity;
+                       auto half = static_cast<float>(circle[2] * mParams.windowScale);
+                       auto tl = cv::Point(cvFloor(predicted.x - half), cvFloor(predicted.y - half));
+                       auto br = cv::Point(cvCeil(predicted.x + half) + 1, cvCeil(predicted.y + half) + 1);
+                       auto fit = findCircleInWindow(image, cv::Rect(tl, br), search);
+                       if(!fit) {
+                           return std::nullopt;
+                       }
+                       auto shift = cv::norm(cv::Point2f((*fit)[0], (*fit)[1]) - predicted);
+                       auto ratio = (*fit)[2] / circle[2];
+                       if(shift > MaxShiftInRadii * circle[2] || ratio < MinRadiusRatio || ratio > MaxRadiusRatio) {
+                           return std::nullopt;
+                       }
+                       return fit;
+                   });
+    auto found = static_cast<int>(std::count_if(fits.begin(), fits.end(), [](const auto& fit){
+        return fit.has_value();
+    }));
+    mConfidence = static_cast<double>(found) / mCircles.size();
+    if(mConfidence < mParams.minConfidence || found < 3) {
+        return false;
+    }
+    // Пропущенные метки переносятся аффинным преобразованием,
+    // оцененным по найденным: previous * motion = current
+    cv::Mat previous(found, 3, CV_32F);
+    cv::Mat current(found, 2, CV_32F);
+    auto row = 0;
+    for(size_t i = 0; i < fits.size(); i++) {
+        if(fits[i]) {
+            auto* src = previous.ptr<float>(row);
+            auto* dst = current.ptr<float>(row);
+            src[0] = mCircles[i][0];
+            src[1] = mCircles[i][1];
+            src[2] = 1.0f;
+            dst[0] = (*fits[i])[0];
+            dst[1] = (*fits[i])[1];
+            ++row;
+        }
+    }
+    cv::Mat motion;
+    if(found < static_cast<int>(fits.size()) && !cv::solve(previous, current, motion, cv::DECOMP_NORMAL)) {
+        std::cerr << __FUNCTION__": can't estimate grid motion" << std::endl;
+        return false;
+    }
+    auto velocity = cv::Point2f{};
+    for(size_t i = 0; i < fits.size(); i++) {
+        auto& circle = mCircles[i];
+        if(fits[i]) {
+            velocity += cv::Point2f((*fits[i])[0] - circle[0], (*fits[i])[1] - circle[1]);
+            circle = *fits[i];
+        } else {
+            cv::Mat moved = cv::Mat(cv::Matx13f(circle[0], circle[1], 1.0f)) * motion;
+            circle = cv::Vec3f(moved.at<float>(0), moved.at<float>(1), circle[2]);
+        }
+    }
+    mVelocity = velocity / found;
+    return true;
+}
+
+void GridTracker::detect(const cv::Mat &image, const GridSearchParams& search) {
+    mCircles = findCirclesGrid(image, search);
+    mVelocity = {};
+    mConfidence = mCircles.empty() ? 0.0 : 1.0;
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Calibration.h"
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace camcalib {
+
+struct TrackingParams {
+    // Параметры полного поиска, gridSize обязателен
+    GridSearchParams search;
+    // Полуширина окна уточнения в радиусах метки
+    double windowScale{1.5};
+    // Доля меток, найденных в окнах, ниже которой выполняется полный поиск
+    double minConfidence{0.9};
+};
+
+// Слежение за сеткой на последовательности кадров: метки уточняются в окнах
+// вокруг предсказанных положений, полный поиск выполняется только при потере сетки
+class GridTracker {
+public:
+    explicit GridTracker(const TrackingParams& params);
+    // Окружности в порядке сетки, пустой результат - сетка не найдена
+    const std::vector<cv::Vec3f>& track(const cv::Mat& image);
+    void reset();
+    const auto& getCircles() const {
+        return mCircles;
+    }
+    std::vector<cv::Point2f> getCenters() const;
+    // Доля меток, найденных в окнах на последнем кадре
+    auto getConfidence() const {
+        return mConfidence;
+    }
+    // Последний кадр обработан полным поиском
+    auto isFullDetection() const {
+        return mFullDetection;
+    }
+private:
+    bool refine(const cv::Mat& image, const GridSearchParams& search);
+    void detect(const cv::Mat& image, const GridSearchParams& search);
+    TrackingParams mParams;
+    std::vector<cv::Vec3f> mCircles;
+    // Смещение сетки за последний кадр, используется для предсказания
+    cv::Point2f mVelocity{};
+    double mConfidence{0.0};
+    bool mFullDetection{false};
+};
+
+}
@@ -0,0 +1,71 @@
+#include "ImageDisplayCache.h"
+#include "Trace.h"
+#include <opencv2/imgproc.hpp>
+#include <QImage>
+#include <cmath>
+
+// Уровни меньше этого размера не строятся
+constexpr auto MinLevelSide = 256;
+
+void ImageDisplayCache::setImage(const cv::Mat &image) {
+    clear();
+    if(!image.empty()) {
+        mLevels.push_back(image);
+    }
+}
+
+void ImageDisplayCache::clear() {
+    mLevels.clear();
+    mPixmaps.clear();
+}
+
+const QPixmap &ImageDisplayCache::pixmapForScale(double scale) {
+    static const auto empty = QPixmap{};
+    if(mLevels.empty()) {
+        return empty;
+    }
+    // Наименьший уровень, разрешение которого не ниже разрешения экрана
+    auto index = size_t{0};
+    if(scale > 0.0 && scale < 1.0) {
+        index = static_cast<size_t>(std::floor(std::log2(1.0 / scale)));
+    }
+    while(index > 0) {
+        const auto& base = mLevels.front();
+        auto side = std::max(base.cols, base.rows) >> index;
+        if(side >= MinLevelSide) {
+            break;
+        }
+        --index;
+    }
+    return pixmap(index);
+}
+
+const QPixmap &ImageDisplayCache::pixmap(size_t index) {
+    if(mPixmaps.size() <= index) {
+        mPixmaps.resize(index + 1);
+    }
+    auto& result = mPixmaps[index];
+    if(result.isNull()) {
+        CAMCALIB_TRACE_SCOPE("ImageDisplayCache::pixmap");
+        const auto& image = level(index);
+        // Отображенные в память кадры могут иметь шаг строки больше ширины
+        auto qimage = QImage(image.data,
+                             image.cols,
+                             image.rows,
+                             static_cast<int>(image.step),
+                             image.depth() == CV_16U ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+        result = QPixmap::fromImage(qimage);
+    }
+    return result;
+}
+
+const cv::Mat &ImageDisplayCache::level(size_t index) {
+    while(mLevels.size() <= index) {
+        CAMCALIB_TRACE_SCOPE("ImageDisplayCache::level");
+        const auto& previous = mLevels.back();
+        cv::Mat next;
+        cv::resize(previous, next, cv::Size((previous.cols + 1) / 2, (previous.rows + 1) / 2), 0.0, 0.0, cv::INTER_AREA);
+        mLevels.push_back(std::move(next));
+    }
+    return mLevels[index];
+}
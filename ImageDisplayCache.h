@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QPixmap>
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Пирамида уменьшенных копий изображения для отображения: уровень выбирается
+// по масштабу вида, уровни и их QPixmap строятся при первом обращении
+// и хранятся до смены изображения
+class ImageDisplayCache {
+public:
+    // Данные изображения разделяются, не копируются
+    void setImage(const cv::Mat& image);
+    void clear();
+    // scale - пикселов экрана на пиксел изображения
+    const QPixmap& pixmapForScale(double scale);
+private:
+    const QPixmap& pixmap(size_t level);
+    const cv::Mat& level(size_t index);
+    std::vector<cv::Mat> mLevels;
+    std::vector<QPixmap> mPixmaps;
+};
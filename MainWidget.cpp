@@ -3,6 +3,7 @@
 #include "WidgetPixelSizeCalibration.h"
 #include "WidgetOpticalCenterSearch.h"
 #include "WidgetCameraModel.h"
+#include "WidgetTraceSummary.h"
 #include <QMessageBox>
 #include <QTabWidget>
 #include <QBoxLayout>
@@ -16,6 +17,7 @@ void MainWidget::setupWidgets() {
     auto tab = new QTabWidget();
     tab->addTab(mWidgetPixelSizeCalibration, tr("Размер пиксела"));
     tab->addTab(mWidgetOpticalCenter, tr("Оптический центр"));
+    tab->addTab(new WidgetTraceSummary(), tr("Трассировка"));
     tab->setCurrentIndex(0);
     auto layout = new QHBoxLayout();
     layout->addWidget(tab);
@@ -0,0 +1,389 @@
+#include "MappedImage.h"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Файл, отображенный в память только для чтения с копированием при записи
+class MappedFile {
+public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    static std::shared_ptr<MappedFile> open(const std::string& filename);
+    ~MappedFile();
+    uchar* data() const {
+        return mData;
+    }
+    size_t size() const {
+        return mSize;
+    }
+private:
+    MappedFile() = default;
+    uchar* mData{};
+    size_t mSize{};
+#ifdef _WIN32
+    HANDLE mFile{INVALID_HANDLE_VALUE};
+    HANDLE mMapping{};
+#endif
+};
+
+#ifdef _WIN32
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &filename) {
+    auto result = std::shared_ptr<MappedFile>(new MappedFile);
+    result->mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size{};
+    if(result->mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(result->mFile, &size) || size.QuadPart == 0) {
+        std::cerr << __FUNCTION__": can't open " << filename << std::endl;
+        return nullptr;
+    }
+    result->mMapping = CreateFileMappingA(result->mFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if(result->mMapping != nullptr) {
+        result->mData = static_cast<uchar*>(MapViewOfFile(result->mMapping, FILE_MAP_COPY, 0, 0, 0));
+    }
+    if(result->mData == nullptr) {
+        std::cerr << __FUNCTION__": can't map " << filename << std::endl;
+        return nullptr;
+    }
+    result->mSize = static_cast<size_t>(size.QuadPart);
+    return result;
+}
+
+MappedFile::~MappedFile() {
+    if(mData != nullptr) {
+        UnmapViewOfFile(mData);
+    }
+    if(mMapping != nullptr) {
+        CloseHandle(mMapping);
+    }
+    if(mFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(mFile);
+    }
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &filename) {
+    auto fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << __FUNCTION__": can't open " << filename << std::endl;
+        return nullptr;
+    }
+    struct stat info{};
+    if(fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << __FUNCTION__": can't stat " << filename << std::endl;
+        ::close(fd);
+        return nullptr;
+    }
+    auto size = static_cast<size_t>(info.st_size);
+    auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED) {
+        std::cerr << __FUNCTION__": can't map " << filename << std::endl;
+        return nullptr;
+    }
+    auto result = std::shared_ptr<MappedFile>(new MappedFile);
+    result->mData = static_cast<uchar*>(data);
+    result->mSize = size;
+    return result;
+}
+
+MappedFile::~MappedFile() {
+    if(mData != nullptr) {
+        munmap(mData, mSize);
+    }
+}
+
+#endif
+
+// Распределитель, который только освобождает ссылку на отображение,
+// когда счетчик ссылок cv::Mat достигает нуля
+class MappingAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int, const int*, int, void*, size_t*,
+                           cv::AccessFlag, cv::UMatUsageFlags) const override {
+        return nullptr;
+    }
+    bool allocate(cv::UMatData*, cv::AccessFlag, cv::UMatUsageFlags) const override {
+        return false;
+    }
+    void deallocate(cv::UMatData* data) const override {
+        if(data != nullptr) {
+            delete static_cast<std::shared_ptr<MappedFile>*>(data->userdata);
+            data->userdata = nullptr;
+            delete data;
+        }
+    }
+};
+
+cv::Mat wrapMapping(const std::shared_ptr<MappedFile>& file, size_t offset,
+                    int rows, int cols, int type, size_t step) {
+    static MappingAllocator allocator;
+    cv::Mat mat(rows, cols, type, file->data() + offset, step);
+    auto data = new cv::UMatData(&allocator);
+    data->data = data->origdata = mat.data;
+    data->size = step * rows;
+    data->userdata = new std::shared_ptr<MappedFile>(file);
+    data->refcount = 1;
+    mat.u = data;
+    mat.allocator = &allocator;
+    return mat;
+}
+
+struct FrameLayout {
+    int width{};
+    int height{};
+    int depth{CV_8U};
+    size_t offset{};
+    size_t stride{};
+    bool bigEndian{false};
+};
+
+class HeaderReader {
+public:
+    HeaderReader(const uchar* data, size_t size, size_t pos)
+        : mData{data}, mSize{size}, mPos{pos} {
+    }
+    void skipSpaces(bool comments) {
+        while(mPos < mSize) {
+            if(std::isspace(mData[mPos])) {
+                ++mPos;
+            } else if(comments && mData[mPos] == '#') {
+                while(mPos < mSize && mData[mPos] != '\n') {
+                    ++mPos;
+                }
+            } else {
+                break;
+            }
+        }
+    }
+    bool readMagic(const char* magic) {
+        skipSpaces(false);
+        if(mPos + 2 > mSize || mData[mPos] != magic[0] || mData[mPos + 1] != magic[1]) {
+            return false;
+        }
+        mPos += 2;
+        return true;
+    }
+    std::optional<int> readInt() {
+        skipSpaces(true);
+        int64_t value = 0;
+        auto start = mPos;
+        while(mPos < mSize && std::isdigit(mData[mPos]) && value <= std::numeric_limits<int>::max()) {
+            value = value * 10 + (mData[mPos++] - '0');
+        }
+        if(mPos == start || value > std::numeric_limits<int>::max()) {
+            return std::nullopt;
+        }
+        return static_cast<int>(value);
+    }
+    // После заголовка PGM ровно один пробельный символ
+    bool skipSingleSpace() {
+        if(mPos >= mSize || !std::isspace(mData[mPos])) {
+            return false;
+        }
+        ++mPos;
+        return true;
+    }
+    auto pos() const {
+        return mPos;
+    }
+private:
+    const uchar* mData;
+    size_t mSize;
+    size_t mPos;
+};
+
+std::vector<FrameLayout> parsePgm(const uchar* data, size_t size) {
+    std::vector<FrameLayout> frames;
+    size_t pos = 0;
+    while(true) {
+        HeaderReader reader(data, size, pos);
+        if(!reader.readMagic("P5")) {
+            break;
+        }
+        auto width = reader.readInt();
+        auto height = reader.readInt();
+        auto maxValue = reader.readInt();
+        if(!width || !height || !maxValue || *width <= 0 || *height <= 0
+            || *maxValue <= 0 || *maxValue > 65535 || !reader.skipSingleSpace()) {
+            std::cerr << __FUNCTION__": invalid PGM header at " << pos << std::endl;
+            break;
+        }
+        FrameLayout layout;
+        layout.width = *width;
+        layout.height = *height;
+        layout.depth = *maxValue < 256 ? CV_8U : CV_16U;
+        layout.offset = reader.pos();
+        layout.stride = static_cast<size_t>(layout.width) * CV_ELEM_SIZE(layout.depth);
+        layout.bigEndian = true;
+        auto frameSize = layout.stride * layout.height;
+        if(layout.offset + frameSize > size) {
+            std::cerr << __FUNCTION__": truncated PGM frame at " << pos << std::endl;
+            break;
+        }
+        frames.push_back(layout);
+        pos = layout.offset + frameSize;
+    }
+    return frames;
+}
+
+template<typename T>
+T readValue(const cv::FileNode& node, T defaultValue) {
+    // Смещения больших файлов не помещаются в int, поэтому чтение через double
+    return node.empty() ? defaultValue : static_cast<T>(static_cast<double>(node));
+}
+
+std::vector<FrameLayout> parseRawDescription(const std::string& filename, size_t size) {
+    auto descriptionFile = filename + ".json";
+    cv::FileStorage storage;
+    try {
+        storage.open(descriptionFile, cv::FileStorage::READ);
+    } catch(const cv::Exception& err) {
+        std::cerr << __FUNCTION__": " << err.what() << std::endl;
+        return {};
+    }
+    if(!storage.isOpened()) {
+        std::cerr << __FUNCTION__": can't open " << descriptionFile << std::endl;
+        return {};
+    }
+    FrameLayout layout;
+    layout.width = readValue(storage["width"], 0);
+    layout.height = readValue(storage["height"], 0);
+    auto bits = readValue(storage["depth"], 8);
+    layout.depth = bits == 16 ? CV_16U : CV_8U;
+    layout.offset = readValue<size_t>(storage["offset"], 0);
+    auto rowSize = static_cast<size_t>(std::max(layout.width, 0)) * CV_ELEM_SIZE(layout.depth);
+    layout.stride = readValue(storage["stride"], rowSize);
+    layout.bigEndian = readValue(storage["big_endian"], 0) != 0;
+    auto frameCount = readValue(storage["frames"], 1);
+    auto frameStep = readValue(storage["frame_step"], layout.stride * std::max(layout.height, 0));
+    if(layout.width <= 0 || layout.height <= 0 || (bits != 8 && bits != 16) || frameCount <= 0
+        || layout.stride < rowSize || layout.stride % CV_ELEM_SIZE(layout.depth) != 0
+        || frameStep < layout.stride * (layout.height - 1) + rowSize) {
+        std::cerr << __FUNCTION__": invalid description " << descriptionFile << std::endl;
+        return {};
+    }
+    std::vector<FrameLayout> frames;
+    for(int i = 0; i < frameCount; i++) {
+        auto end = layout.offset + layout.stride * (layout.height - 1) + rowSize;
+        if(end > size) {
+            std::cerr << __FUNCTION__": " << filename << " is shorter than described" << std::endl;
+            break;
+        }
+        frames.push_back(layout);
+        layout.offset += frameStep;
+    }
+    return frames;
+}
+
+inline bool isBigEndianHost() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uchar*>(&probe) == 0;
+}
+
+cv::Mat copyDecoded16(const uchar* data, const FrameLayout& layout) {
+    cv::Mat frame(layout.height, layout.width, CV_16U);
+    auto high = layout.bigEndian ? 0 : 1;
+    for(int y = 0; y < layout.height; y++) {
+        const auto* src = data + layout.offset + y * layout.stride;
+        auto* dst = frame.ptr<ushort>(y);
+        for(int x = 0; x < layout.width; x++) {
+            dst[x] = static_cast<ushort>((src[2 * x + high] << 8) | src[2 * x + 1 - high]);
+        }
+    }
+    return frame;
+}
+
+std::string lowerExtension(const std::string& filename) {
+    auto ext = std::filesystem::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){
+        return static_cast<char>(std::tolower(c));
+    });
+    return ext;
+}
+
+}
+
+namespace camcalib {
+
+bool isMappedImageFile(const std::string &filename) {
+    auto ext = lowerExtension(filename);
+    return ext == ".pgm" || ext == ".raw";
+}
+
+std::vector<MappedFrame> mapImageFrames(const std::string &filename) {
+    auto file = MappedFile::open(filename);
+    if(!file) {
+        return {};
+    }
+    auto layouts = lowerExtension(filename) == ".raw"
+        ? parseRawDescription(filename, file->size())
+        : parsePgm(file->data(), file->size());
+    std::vector<MappedFrame> frames;
+    for(const auto& layout: layouts) {
+        auto wide = layout.depth == CV_16U;
+        // Невыровненные 16-битные данные копируются сразу, перестановка байтов
+        // остальных откладывается до toHostByteOrder
+        if(wide && layout.offset % 2 != 0) {
+            frames.push_back({copyDecoded16(file->data(), layout), false});
+        } else {
+            frames.push_back({wrapMapping(file, layout.offset, layout.height, layout.width,
+                                          layout.depth, layout.stride),
+                              wide && layout.bigEndian != isBigEndianHost()});
+        }
+    }
+    return frames;
+}
+
+cv::Mat toHostByteOrder(const cv::Mat &image, const cv::Rect &rect, bool swappedByteOrder) {
+    cv::Mat part = image(rect);
+    if(!swappedByteOrder) {
+        return part;
+    }
+    cv::Mat result(part.size(), CV_16U);
+    for(int y = 0; y < part.rows; y++) {
+        const auto* src = part.ptr<ushort>(y);
+        auto* dst = result.ptr<ushort>(y);
+        for(int x = 0; x < part.cols; x++) {
+            dst[x] = static_cast<ushort>((src[x] << 8) | (src[x] >> 8));
+        }
+    }
+    return result;
+}
+
+cv::Mat toHostByteOrder(const MappedFrame &frame) {
+    return toHostByteOrder(frame.image, cv::Rect(cv::Point{}, frame.image.size()), frame.swappedByteOrder);
+}
+
+MappedFrame mapGrayscaleImage(const std::string &filename) {
+    if(isMappedImageFile(filename)) {
+        auto frames = mapImageFrames(filename);
+        return frames.empty() ? MappedFrame{} : frames.front();
+    }
+    return {cv::imread(filename, cv::IMREAD_GRAYSCALE), false};
+}
+
+cv::Mat readGrayscaleImage(const std::string &filename) {
+    return toHostByteOrder(mapGrayscaleImage(filename));
+}
+
+}
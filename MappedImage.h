@@ -0,0 +1,40 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+namespace camcalib {
+
+// Файлы, которые читаются через отображение в память: .pgm (P5) и .raw
+bool isMappedImageFile(const std::string& filename);
+
+// Кадр отображенного файла. 16-битные данные с порядком байтов, отличным от порядка
+// процессора (в т.ч. все 16-битные PGM), не переставляются при отображении:
+// image читается только через toHostByteOrder или функции поиска меток
+// с GridSearchParams::swappedByteOrder (detectGridCorrespondences для MappedFrame).
+struct MappedFrame {
+    cv::Mat image;
+    bool swappedByteOrder{false};
+};
+
+// Кадры .pgm (P5, 8 и 16 бит, несколько изображений подряд) или .raw с описанием
+// в файле <filename>.json: width, height, depth (8 или 16), offset, stride,
+// frames, frame_step, big_endian. Кадры ссылаются на отображенный файл без копирования,
+// отображение освобождается вместе с последним cv::Mat, который на него ссылается.
+// Страницы отображены с копированием при записи, файл не изменяется.
+std::vector<MappedFrame> mapImageFrames(const std::string& filename);
+
+// Область rect в порядке байтов процессора: копия с перестановкой для swappedByteOrder,
+// иначе - ссылка без копирования
+cv::Mat toHostByteOrder(const cv::Mat& image, const cv::Rect& rect, bool swappedByteOrder);
+// Кадр целиком в порядке байтов процессора
+cv::Mat toHostByteOrder(const MappedFrame& frame);
+
+// Первый кадр отображенного файла без перестановки байтов или cv::imread в полутоновое изображение
+MappedFrame mapGrayscaleImage(const std::string& filename);
+
+// Первый кадр в порядке байтов процессора, остальные кадры файла не читаются
+cv::Mat readGrayscaleImage(const std::string& filename);
+
+}
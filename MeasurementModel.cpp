@@ -0,0 +1,249 @@
+#include "MeasurementModel.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace camcalib {
+
+void writeMeasurementModel(cv::FileStorage& storage, const MeasurementModel& model) {
+    if(model.opticalCenter) {
+        storage << "optical_center" << *model.opticalCenter;
+    }
+    if(model.distortion) {
+        writeDistortion(storage, "distortion", *model.distortion);
+    }
+    storage << "magnifications" << "[";
+    for(const auto& magn: model.magnifications) {
+        storage << "{"
+                << "name" << magn.name
+                << "pixel_size" << magn.pixelSize
+                << "}";
+    }
+    storage << "]";
+}
+
+MeasurementModel readMeasurementModel(const cv::FileStorage& storage) {
+    MeasurementModel model;
+    if(auto node = storage["optical_center"]; !node.empty()) {
+        model.opticalCenter.emplace();
+        node >> *model.opticalCenter;
+    }
+    if(auto node = storage["distortion"]; !node.empty()) {
+        model.distortion = readDistortion(node);
+    }
+    for(const auto& node: storage["magnifications"]) {
+        Magnification magn;
+        node["name"] >> magn.name;
+        node["pixel_size"] >> magn.pixelSize;
+        model.magnifications.emplace_back(std::move(magn));
+    }
+    return model;
+}
+
+std::optional<MeasurementModel> loadMeasurementModel(const std::string& filename) {
+    cv::FileStorage storage(filename, cv::FileStorage::READ);
+    if(!storage.isOpened()) {
+        std::cerr << __FUNCTION__": can't open " << filename << std::endl;
+        return std::nullopt;
+    }
+    return readMeasurementModel(storage);
+}
+
+namespace {
+
+// Максимальное число итераций и квадрат шага, при котором итерации worldToPixel
+// останавливаются, пикс^2. Порог выше погрешности float для координат кадра 20 Мп.
+constexpr auto MaxIterations = 100;
+constexpr auto Tolerance = 1e-6f;
+
+// Коэффициенты преобразования, одинаковые для всех точек.
+// T - float для скалярного хвоста или вектор SIMD с размноженными значениями.
+template<typename T>
+struct TransformTerms {
+    T cx, cy;
+    T k1, k2, p1, p2, s1, s2;
+    T twoP1, twoP2, three;
+    // Начало мировых координат и масштаб
+    T ox, oy;
+    T sx, sy;
+    T invSx, invSy;
+    T tolerance;
+};
+
+TransformTerms<float> makeTerms(const cv::Size2d& pixelSize,
+                                const cv::Point2d& origin,
+                                const std::optional<LensDistortion>& distortion) {
+    auto d = distortion.value_or(LensDistortion{});
+    auto f = [](double value) {
+        return static_cast<float>(value);
+    };
+    return {
+        f(d.center.x), f(d.center.y),
+        f(d.k1), f(d.k2), f(d.p1), f(d.p2), f(d.s1), f(d.s2),
+        f(2.0 * d.p1), f(2.0 * d.p2), 3.0f,
+        f(origin.x), f(origin.y),
+        f(pixelSize.width), f(pixelSize.height),
+        f(1.0 / pixelSize.width), f(1.0 / pixelSize.height),
+        Tolerance
+    };
+}
+
+#if CV_SIMD128
+TransformTerms<cv::v_float32x4> broadcast(const TransformTerms<float>& t) {
+    auto b = [](float value) {
+        return cv::v_setall_f32(value);
+    };
+    return {
+        b(t.cx), b(t.cy),
+        b(t.k1), b(t.k2), b(t.p1), b(t.p2), b(t.s1), b(t.s2),
+        b(t.twoP1), b(t.twoP2), b(t.three),
+        b(t.ox), b(t.oy),
+        b(t.sx), b(t.sy),
+        b(t.invSx), b(t.invSy),
+        b(t.tolerance)
+    };
+}
+
+inline bool allBelow(const cv::v_float32x4& value, const cv::v_float32x4& limit) {
+    return cv::v_check_all(value < limit);
+}
+#endif
+
+inline bool allBelow(float value, float limit) {
+    return value < limit;
+}
+
+// Сдвиг дисторсии (distortionShift) для точки (du, dv) относительно центра дисторсии
+template<typename T>
+inline void shiftOf(const TransformTerms<T>& t, const T& du, const T& dv, T& su, T& sv) {
+    auto uu = du * du;
+    auto vv = dv * dv;
+    auto uv = du * dv;
+    auto r = uu + vv;
+    auto radial = r * (t.k1 + t.k2 * r);
+    su = du * radial + t.p1 * (t.three * uu + vv) + t.twoP2 * uv + t.s1 * r;
+    sv = dv * radial + t.twoP1 * uv + t.p2 * (uu + t.three * vv) + t.s2 * r;
+}
+
+template<typename T, bool Distorted>
+inline void toWorld(const TransformTerms<T>& t, const T& x, const T& y, T& wx, T& wy) {
+    auto ux = x;
+    auto uy = y;
+    if constexpr (Distorted) {
+        T su, sv;
+        shiftOf(t, x - t.cx, y - t.cy, su, sv);
+        ux = x - su;
+        uy = y - sv;
+    }
+    wx = (ux - t.ox) * t.sx;
+    wy = (uy - t.oy) * t.sy;
+}
+
+template<typename T, bool Distorted>
+inline void toPixel(const TransformTerms<T>& t, const T& wx, const T& wy, T& x, T& y) {
+    auto ux = wx * t.invSx + t.ox;
+    auto uy = wy * t.invSy + t.oy;
+    x = ux;
+    y = uy;
+    if constexpr (Distorted) {
+        // Итерации в координатах относительно центра дисторсии
+        auto du0 = ux - t.cx;
+        auto dv0 = uy - t.cy;
+        auto du = du0;
+        auto dv = dv0;
+        for(int iteration = 0; iteration < MaxIterations; iteration++) {
+            T su, sv;
+            shiftOf(t, du, dv, su, sv);
+            auto nextU = du0 + su;
+            auto nextV = dv0 + sv;
+            auto deltaU = nextU - du;
+            auto deltaV = nextV - dv;
+            du = nextU;
+            dv = nextV;
+            if(allBelow(deltaU * deltaU + deltaV * deltaV, t.tolerance)) {
+                break;
+            }
+        }
+        x = du + t.cx;
+        y = dv + t.cy;
+    }
+}
+
+// Точки Point2f читаются парами компонент, 4 точки за шаг
+template<bool Distorted, bool Inverse>
+void transformPoints(const TransformTerms<float>& t, const cv::Point2f* src, cv::Point2f* dst, size_t count) {
+    size_t i = 0;
+#if CV_SIMD128
+    auto vt = broadcast(t);
+    for(; i + 4 <= count; i += 4) {
+        cv::v_float32x4 x, y, rx, ry;
+        cv::v_load_deinterleave(&src[i].x, x, y);
+        if constexpr (Inverse) {
+            toPixel<cv::v_float32x4, Distorted>(vt, x, y, rx, ry);
+        } else {
+            toWorld<cv::v_float32x4, Distorted>(vt, x, y, rx, ry);
+        }
+        cv::v_store_interleave(&dst[i].x, rx, ry);
+    }
+#endif
+    for(; i < count; i++) {
+        float rx, ry;
+        if constexpr (Inverse) {
+            toPixel<float, Distorted>(t, src[i].x, src[i].y, rx, ry);
+        } else {
+            toWorld<float, Distorted>(t, src[i].x, src[i].y, rx, ry);
+        }
+        dst[i] = cv::Point2f(rx, ry);
+    }
+}
+
+}
+
+PixelWorldTransform::PixelWorldTransform(const cv::Size2d& pixelSize,
+                                         const cv::Point2d& origin,
+                                         const std::optional<LensDistortion>& distortion)
+    : mPixelSize{pixelSize}, mOrigin{origin}, mDistortion{distortion} {
+}
+
+void PixelWorldTransform::pixelToWorld(const cv::Point2f* src, cv::Point2f* dst, size_t count) const {
+    auto terms = makeTerms(mPixelSize, mOrigin, mDistortion);
+    if(mDistortion) {
+        transformPoints<true, false>(terms, src, dst, count);
+    } else {
+        transformPoints<false, false>(terms, src, dst, count);
+    }
+}
+
+void PixelWorldTransform::worldToPixel(const cv::Point2f* src, cv::Point2f* dst, size_t count) const {
+    auto terms = makeTerms(mPixelSize, mOrigin, mDistortion);
+    if(mDistortion) {
+        transformPoints<true, true>(terms, src, dst, count);
+    } else {
+        transformPoints<false, true>(terms, src, dst, count);
+    }
+}
+
+std::vector<cv::Point2f> PixelWorldTransform::pixelToWorld(const std::vector<cv::Point2f>& points) const {
+    std::vector<cv::Point2f> result(points.size());
+    pixelToWorld(points.data(), result.data(), points.size());
+    return result;
+}
+
+std::vector<cv::Point2f> PixelWorldTransform::worldToPixel(const std::vector<cv::Point2f>& points) const {
+    std::vector<cv::Point2f> result(points.size());
+    worldToPixel(points.data(), result.data(), points.size());
+    return result;
+}
+
+std::optional<PixelWorldTransform> makePixelWorldTransform(const MeasurementModel& model,
+                                                           const std::string& magnification) {
+    auto magn = std::find_if(model.magnifications.begin(), model.magnifications.end(), [&](const auto& m) {
+        return m.name == magnification;
+    });
+    if(magn == model.magnifications.end()) {
+        return std::nullopt;
+    }
+    return PixelWorldTransform{magn->pixelSize, model.opticalCenter.value_or(cv::Point2d{}), model.distortion};
+}
+
+}
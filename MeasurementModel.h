@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Distortion.h"
+#include <opencv2/core.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace camcalib {
+
+struct Magnification {
+    std::string name;
+    // Размер пиксела в единицах шага шаблона
+    cv::Size2d pixelSize;
+};
+
+// Модель камеры в файле CameraModel::saveToFile
+struct MeasurementModel {
+    std::optional<cv::Point2d> opticalCenter;
+    std::optional<LensDistortion> distortion;
+    std::vector<Magnification> magnifications;
+};
+
+void writeMeasurementModel(cv::FileStorage& storage, const MeasurementModel& model);
+MeasurementModel readMeasurementModel(const cv::FileStorage& storage);
+// Пустой результат - файл не открывается
+std::optional<MeasurementModel> loadMeasurementModel(const std::string& filename);
+
+// Пересчет координат одного увеличения: исправление дисторсии, перенос начала
+// в оптический центр (без него - в начало изображения) и масштаб pixelSize.
+// Оси мировых координат совпадают с осями изображения.
+// Неизменяем после создания, методы можно вызывать из любого числа потоков.
+class PixelWorldTransform {
+public:
+    PixelWorldTransform(const cv::Size2d& pixelSize,
+                        const cv::Point2d& origin,
+                        const std::optional<LensDistortion>& distortion);
+    // count точек подряд, src и dst могут совпадать
+    void pixelToWorld(const cv::Point2f* src, cv::Point2f* dst, size_t count) const;
+    // Обратное преобразование дисторсии простой итерацией, как distortPoint
+    void worldToPixel(const cv::Point2f* src, cv::Point2f* dst, size_t count) const;
+    std::vector<cv::Point2f> pixelToWorld(const std::vector<cv::Point2f>& points) const;
+    std::vector<cv::Point2f> worldToPixel(const std::vector<cv::Point2f>& points) const;
+    const cv::Size2d& getPixelSize() const {
+        return mPixelSize;
+    }
+    const cv::Point2d& getOrigin() const {
+        return mOrigin;
+    }
+private:
+    cv::Size2d mPixelSize;
+    cv::Point2d mOrigin;
+    std::optional<LensDistortion> mDistortion;
+};
+
+// Пустой результат - увеличения с таким именем нет
+std::optional<PixelWorldTransform> makePixelWorldTransform(const MeasurementModel& model,
+                                                           const std::string& magnification);
+
+}
@@ -0,0 +1,138 @@
+#include "OpticalCenter.h"
+#include "Trace.h"
+#include <limits>
+#include <sstream>
+
+namespace camcalib {
+
+namespace {
+
+constexpr auto MaxIterations = 5;
+// Вес невязки радиуса: среднее cos^2 по точкам окружности
+constexpr auto RadiusWeight = 0.5;
+
+struct AxisSolution {
+    double center{};
+    double centerVariance{};
+    std::vector<double> scales;
+    std::vector<double> scaleVariances;
+    int iterations{};
+};
+
+// Одна ось: f_i = s_i * ref + (1 - s_i) * x0 для центров и s_i * r0 = r_i для радиусов.
+// Матрица нормальных уравнений - стрелка (x0 связан со всеми s_i), решается дополнением Шура.
+std::optional<AxisSolution> solveAxis(const std::vector<cv::Vec3f>& circles, int axis) {
+    const auto n = circles.size() - 1;
+    const double ref = circles[0][axis];
+    const double refRadius = circles[0][2];
+    if(refRadius <= 0.0) {
+        return std::nullopt;
+    }
+    AxisSolution result;
+    // Линейная оценка: s_i по радиусам, a_i = (1 - s_i) x0 по центрам
+    auto numerator = 0.0;
+    auto denominator = 0.0;
+    for(size_t i = 1; i <= n; i++) {
+        auto s = circles[i][2] / refRadius;
+        auto a = circles[i][axis] - s * ref;
+        numerator += (1.0 - s) * a;
+        denominator += (1.0 - s) * (1.0 - s);
+        result.scales.push_back(s);
+    }
+    if(denominator < 1e-12) {
+        // Увеличение не менялось, центр не определен
+        return std::nullopt;
+    }
+    auto& x0 = result.center;
+    x0 = numerator / denominator;
+
+    std::vector<double> h0i(n), hii(n), gi(n);
+    auto schur = 0.0;
+    auto residualSum = 0.0;
+    auto evaluate = [&] {
+        auto h00 = 0.0;
+        auto g0 = 0.0;
+        residualSum = 0.0;
+        for(size_t i = 0; i < n; i++) {
+            const auto& circle = circles[i + 1];
+            auto s = result.scales[i];
+            auto centerResidual = s * ref + (1.0 - s) * x0 - circle[axis];
+            auto radiusResidual = s * refRadius - circle[2];
+            h00 += (1.0 - s) * (1.0 - s);
+            h0i[i] = (1.0 - s) * (ref - x0);
+            hii[i] = (ref - x0) * (ref - x0) + RadiusWeight * refRadius * refRadius;
+            g0 += (1.0 - s) * centerResidual;
+            gi[i] = (ref - x0) * centerResidual + RadiusWeight * refRadius * radiusResidual;
+            residualSum += centerResidual * centerResidual + RadiusWeight * radiusResidual * radiusResidual;
+        }
+        schur = h00;
+        auto rhs = -g0;
+        for(size_t i = 0; i < n; i++) {
+            schur -= h0i[i] * h0i[i] / hii[i];
+            rhs += h0i[i] * gi[i] / hii[i];
+        }
+        return rhs;
+    };
+    for(result.iterations = 0; result.iterations < MaxIterations; result.iterations++) {
+        auto rhs = evaluate();
+        if(schur <= 0.0) {
+            return std::nullopt;
+        }
+        auto dx0 = rhs / schur;
+        auto maxStep = std::abs(dx0);
+        x0 += dx0;
+        for(size_t i = 0; i < n; i++) {
+            auto ds = (-gi[i] - h0i[i] * dx0) / hii[i];
+            result.scales[i] += ds;
+            maxStep = std::max(maxStep, std::abs(ds) * refRadius);
+        }
+        if(maxStep < 1e-9) {
+            break;
+        }
+    }
+    evaluate();
+    // Дисперсия невязки по 2n наблюдениям и n + 1 параметрам. Для двух окружностей
+    // степеней свободы нет, решение точное и его погрешность не определена.
+    auto dof = static_cast<double>(n) - 1.0;
+    auto sigma2 = dof > 0.0 ? residualSum / dof : std::numeric_limits<double>::infinity();
+    result.centerVariance = sigma2 / schur;
+    for(size_t i = 0; i < n; i++) {
+        auto ratio = h0i[i] / hii[i];
+        result.scaleVariances.push_back(sigma2 * (1.0 / hii[i] + ratio * ratio / schur));
+    }
+    return result;
+}
+
+}
+
+std::optional<OpticalCenterSolution> findOpticalCenter(const std::vector<cv::Vec3f>& circles,
+                                                       const ProgressCallback& progress) {
+    CAMCALIB_TRACE_SCOPE("findOpticalCenter");
+    if(circles.size() <= 1 || !reportStage(progress, CalibrationStage::Solve)) {
+        return std::nullopt;
+    }
+    auto x = solveAxis(circles, 0);
+    auto y = solveAxis(circles, 1);
+    if(!x || !y) {
+        return std::nullopt;
+    }
+    OpticalCenterSolution solution;
+    solution.center = {x->center, y->center};
+    solution.covariance = cv::Matx22d(x->centerVariance, 0.0,
+                                      0.0, y->centerVariance);
+    for(size_t i = 0; i < x->scales.size(); i++) {
+        solution.scales.emplace_back(x->scales[i], y->scales[i]);
+        solution.scaleDeviations.emplace_back(std::sqrt(x->scaleVariances[i]), std::sqrt(y->scaleVariances[i]));
+    }
+    std::ostringstream os;
+    os << "iterations: " << x->iterations << ", " << y->iterations << std::endl;
+    os << "center: " << solution.center
+       << " +- (" << std::sqrt(x->centerVariance) << ", " << std::sqrt(y->centerVariance) << ")" << std::endl;
+    for(size_t i = 0; i < solution.scales.size(); i++) {
+        os << "scale " << i + 1 << ": " << solution.scales[i] << " +- " << solution.scaleDeviations[i] << std::endl;
+    }
+    solution.report = os.str();
+    return solution;
+}
+
+}
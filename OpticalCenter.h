@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Progress.h"
+#include <opencv2/core.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace camcalib {
+
+struct OpticalCenterSolution {
+    cv::Point2d center;
+    // Ковариация центра, пикселы^2 (оси независимы, внедиагональные элементы нулевые).
+    // Для двух окружностей не определена: диагональ и scaleDeviations - бесконечность.
+    cv::Matx22d covariance;
+    // Масштабы (sx, sy) окружности i + 1 относительно первой и их СКО
+    std::vector<cv::Vec2d> scales;
+    std::vector<cv::Vec2d> scaleDeviations;
+    // Ход решения и найденные параметры
+    std::string report;
+};
+
+// Центр масштабирования по одной метке, снятой при разных увеличениях
+// (первая окружность - базовое увеличение). Не менее двух окружностей.
+// Модель: точка p при увеличении i переходит в s_i * p + (1 - s_i) * center по каждой оси,
+// для окружности это центр c_i = s_i * c_0 + (1 - s_i) * center и радиус r_i = s_i * r_0.
+// Линейное начальное приближение и несколько шагов Гаусса-Ньютона, оси решаются раздельно.
+std::optional<OpticalCenterSolution> findOpticalCenter(const std::vector<cv::Vec3f>& circles,
+                                                       const ProgressCallback& progress = {});
+
+}
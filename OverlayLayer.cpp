@@ -0,0 +1,106 @@
+#include "OverlayLayer.h"
+#include "Graphics.h"
+#include "Trace.h"
+#include <algorithm>
+
+// Полуразмер креста узла в пикселах изображения
+constexpr auto CrossSize = 10.0;
+constexpr auto MaxCellsPerSide = 32;
+
+void OverlayLayer::setGridPoints(const std::vector<cv::Point2f> &points) {
+    mPoints = points;
+    rebuild();
+}
+
+void OverlayLayer::setCircles(const std::vector<cv::Vec3f> &circles) {
+    mCircles = circles;
+    rebuild();
+}
+
+void OverlayLayer::setRects(const std::vector<cv::Rect> &rects) {
+    mRects = rects;
+    rebuild();
+}
+
+void OverlayLayer::clear() {
+    mPoints.clear();
+    mCircles.clear();
+    mRects.clear();
+    rebuild();
+}
+
+void OverlayLayer::rebuild() {
+    CAMCALIB_TRACE_SCOPE("OverlayLayer::rebuild");
+    mCells.clear();
+    mColumns = mRows = 0;
+    mMargin = mPoints.empty() ? 0.0 : CrossSize;
+    auto bounds = QRectF{};
+    for(const auto& point: mPoints) {
+        bounds |= QRectF(point.x, point.y, 0.0, 0.0).adjusted(-0.5, -0.5, 0.5, 0.5);
+    }
+    for(const auto& circle: mCircles) {
+        bounds |= QRectF(circle[0], circle[1], 0.0, 0.0).adjusted(-0.5, -0.5, 0.5, 0.5);
+        mMargin = std::max(mMargin, static_cast<double>(circle[2]));
+    }
+    for(const auto& rect: mRects) {
+        auto center = (cv::Point2d(rect.tl()) + cv::Point2d(rect.br())) * 0.5;
+        bounds |= QRectF(center.x, center.y, 0.0, 0.0).adjusted(-0.5, -0.5, 0.5, 0.5);
+        mMargin = std::max(mMargin, 0.5 * std::max(rect.width, rect.height) + 1.0);
+    }
+    if(bounds.isEmpty()) {
+        return;
+    }
+    mBounds = bounds;
+    mCellSize = std::max(bounds.width(), bounds.height()) / MaxCellsPerSide;
+    mColumns = static_cast<int>(bounds.width() / mCellSize) + 1;
+    mRows = static_cast<int>(bounds.height() / mCellSize) + 1;
+    mCells.resize(static_cast<size_t>(mColumns) * mRows);
+    auto cellAt = [this](double x, double y) -> Cell& {
+        auto col = std::clamp(static_cast<int>((x - mBounds.left()) / mCellSize), 0, mColumns - 1);
+        auto row = std::clamp(static_cast<int>((y - mBounds.top()) / mCellSize), 0, mRows - 1);
+        return mCells[static_cast<size_t>(row) * mColumns + col];
+    };
+    for(const auto& point: mPoints) {
+        auto& cell = cellAt(point.x, point.y);
+        cell.crosses.append(QLineF(point.x - CrossSize, point.y, point.x + CrossSize, point.y));
+        cell.crosses.append(QLineF(point.x, point.y - CrossSize, point.x, point.y + CrossSize));
+    }
+    for(const auto& circle: mCircles) {
+        cellAt(circle[0], circle[1]).circles.addEllipse(QPointF(circle[0], circle[1]), circle[2], circle[2]);
+    }
+    for(const auto& rect: mRects) {
+        auto center = (cv::Point2d(rect.tl()) + cv::Point2d(rect.br())) * 0.5;
+        cellAt(center.x, center.y).rects.addRect(rect.x, rect.y, rect.width, rect.height);
+    }
+}
+
+void OverlayLayer::draw(const Graphics &graphics) const {
+    if(mCells.empty()) {
+        return;
+    }
+    CAMCALIB_TRACE_SCOPE("OverlayLayer::draw");
+    auto visible = graphics.getVisibleRect().adjusted(-mMargin, -mMargin, mMargin, mMargin) & mBounds;
+    if(visible.isEmpty()) {
+        return;
+    }
+    auto firstColumn = std::clamp(static_cast<int>((visible.left() - mBounds.left()) / mCellSize), 0, mColumns - 1);
+    auto lastColumn = std::clamp(static_cast<int>((visible.right() - mBounds.left()) / mCellSize), 0, mColumns - 1);
+    auto firstRow = std::clamp(static_cast<int>((visible.top() - mBounds.top()) / mCellSize), 0, mRows - 1);
+    auto lastRow = std::clamp(static_cast<int>((visible.bottom() - mBounds.top()) / mCellSize), 0, mRows - 1);
+    mVisibleCrosses.clear();
+    for(auto row = firstRow; row <= lastRow; row++) {
+        for(auto col = firstColumn; col <= lastColumn; col++) {
+            const auto& cell = mCells[static_cast<size_t>(row) * mColumns + col];
+            mVisibleCrosses += cell.crosses;
+            if(!cell.rects.isEmpty()) {
+                graphics.drawCandidates(cell.rects);
+            }
+            if(!cell.circles.isEmpty()) {
+                graphics.drawCircles(cell.circles);
+            }
+        }
+    }
+    if(!mVisibleCrosses.isEmpty()) {
+        graphics.drawCrosses(mVisibleCrosses);
+    }
+}
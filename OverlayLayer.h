@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QPainterPath>
+#include <QRectF>
+#include <QVector>
+#include <opencv2/core.hpp>
+#include <vector>
+
+class Graphics;
+
+// Метки поверх изображения: кресты узлов сетки, окружности и рамки компонент.
+// Примитивы строятся при изменении меток и раскладываются по ячейкам равномерной сетки,
+// при рисовании берутся только ячейки, пересекающие видимую часть изображения.
+class OverlayLayer {
+public:
+    void setGridPoints(const std::vector<cv::Point2f>& points);
+    void setCircles(const std::vector<cv::Vec3f>& circles);
+    void setRects(const std::vector<cv::Rect>& rects);
+    void clear();
+    bool empty() const {
+        return mCells.empty();
+    }
+    void draw(const Graphics& graphics) const;
+private:
+    struct Cell {
+        QVector<QLineF> crosses;
+        QPainterPath circles;
+        QPainterPath rects;
+    };
+    void rebuild();
+    std::vector<cv::Point2f> mPoints;
+    std::vector<cv::Vec3f> mCircles;
+    std::vector<cv::Rect> mRects;
+    std::vector<Cell> mCells;
+    QRectF mBounds;
+    double mCellSize{1.0};
+    int mColumns{};
+    int mRows{};
+    // Наибольший выход примитива за ячейку своего центра
+    double mMargin{};
+    // Кресты видимых ячеек, собираются для одного вызова drawLines
+    mutable QVector<QLineF> mVisibleCrosses;
+};
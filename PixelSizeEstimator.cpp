@@ -0,0 +1,90 @@
+#include "PixelSizeEstimator.h"
+#include "Calibration.h"
+#include "Trace.h"
+
+namespace camcalib {
+
+bool PixelSizeEstimator::addFrame(const std::vector<cv::Point2f>& centersImage,
+                                  const std::vector<cv::Point2f>& centersWorld) {
+    CAMCALIB_TRACE_SCOPE("PixelSizeEstimator::addFrame");
+    const auto count = centersImage.size();
+    if(count != centersWorld.size() || count < 3) {
+        return false;
+    }
+    // Суммы относительно первой точки: без потери точности на больших координатах
+    const auto originImage = cv::Point2d(centersImage.front());
+    const auto originWorld = cv::Point2d(centersWorld.front());
+    cv::Point2d sumImage{}, sumWorld{};
+    cv::Matx22d worldWorld{}, imageWorld{};
+    for(size_t i = 0; i < count; i++) {
+        auto u = cv::Point2d(centersImage[i]) - originImage;
+        auto w = cv::Point2d(centersWorld[i]) - originWorld;
+        sumImage += u;
+        sumWorld += w;
+        worldWorld += cv::Matx22d(w.x * w.x, w.x * w.y,
+                                  w.x * w.y, w.y * w.y);
+        imageWorld += cv::Matx22d(u.x * w.x, u.x * w.y,
+                                  u.y * w.x, u.y * w.y);
+    }
+    const auto n = static_cast<double>(count);
+    const auto meanImage = sumImage * (1.0 / n);
+    const auto meanWorld = sumWorld * (1.0 / n);
+    // Центрирование: сумма (a - mean_a)(b - mean_b) = сумма a b - n mean_a mean_b
+    worldWorld -= n * cv::Matx22d(meanWorld.x * meanWorld.x, meanWorld.x * meanWorld.y,
+                                  meanWorld.x * meanWorld.y, meanWorld.y * meanWorld.y);
+    imageWorld -= n * cv::Matx22d(meanImage.x * meanWorld.x, meanImage.x * meanWorld.y,
+                                  meanImage.y * meanWorld.x, meanImage.y * meanWorld.y);
+    // Точки сетки на одной прямой
+    auto det = cv::determinant(worldWorld);
+    if(!(det > 1e-12 * cv::trace(worldWorld) * cv::trace(worldWorld))) {
+        return false;
+    }
+    // M = (u~ w~^T) (w~ w~^T)^-1, ~ - отклонение от среднего кадра.
+    // Поворот кадра отделяется до усреднения, иначе кадры с разными углами
+    // уменьшают средний масштаб.
+    auto m = imageWorld * worldWorld.inv();
+    auto [f, r] = factorizeCameraMatrix(cv::Matx33d(m(0, 0), m(0, 1), 0.0,
+                                                    m(1, 0), m(1, 1), 0.0,
+                                                    0.0, 0.0, 1.0));
+    mCameraSum += n * cv::Matx22d(f(0, 0), f(0, 1),
+                                  f(1, 0), f(1, 1));
+    mLastRotation = cv::Matx22d(r(0, 0), r(0, 1),
+                                r(1, 0), r(1, 1));
+    mLastImageMean = meanImage + originImage;
+    mLastWorldMean = meanWorld + originWorld;
+    ++mFrames;
+    mPoints += count;
+    return true;
+}
+
+void PixelSizeEstimator::reset() {
+    *this = PixelSizeEstimator{};
+}
+
+std::optional<cv::Matx33d> PixelSizeEstimator::projectionMatrix() const {
+    if(mFrames == 0) {
+        return std::nullopt;
+    }
+    auto m = mCameraSum * (1.0 / static_cast<double>(mPoints)) * mLastRotation;
+    auto t = mLastImageMean - cv::Point2d(m(0, 0) * mLastWorldMean.x + m(0, 1) * mLastWorldMean.y,
+                                          m(1, 0) * mLastWorldMean.x + m(1, 1) * mLastWorldMean.y);
+    return cv::Matx33d(m(0, 0), m(0, 1), t.x,
+                       m(1, 0), m(1, 1), t.y,
+                       0.0, 0.0, 1.0);
+}
+
+std::optional<cv::Matx33d> PixelSizeEstimator::cameraMatrix() const {
+    if(auto projection = projectionMatrix()) {
+        return factorizeCameraMatrix(*projection).first;
+    }
+    return std::nullopt;
+}
+
+std::optional<cv::Size2d> PixelSizeEstimator::pixelSize() const {
+    if(auto f = cameraMatrix()) {
+        return cv::Size2d{1.0 / (*f)(0, 0), 1.0 / (*f)(1, 1)};
+    }
+    return std::nullopt;
+}
+
+}
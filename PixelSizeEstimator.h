@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <optional>
+#include <vector>
+
+namespace camcalib {
+
+// Оценка uv_image = P * xy_world по многим кадрам. Сдвиг и поворот свои у каждого кадра
+// (мишень может смещаться и поворачиваться), общий - множитель F разложения
+// factorizeCameraMatrix. Линейная часть кадра находится по центрированным суммам за один
+// проход по точкам, F кадров усредняется с весом числа точек.
+// Для одного кадра результат совпадает с calibrate.
+class PixelSizeEstimator {
+public:
+    // false - меньше трех точек или точки сетки на одной прямой, кадр не учитывается
+    bool addFrame(const std::vector<cv::Point2f>& centersImage,
+                  const std::vector<cv::Point2f>& centersWorld);
+    void reset();
+    size_t frameCount() const {
+        return mFrames;
+    }
+    size_t pointCount() const {
+        return mPoints;
+    }
+    // P с поворотом и сдвигом последнего кадра
+    std::optional<cv::Matx33d> projectionMatrix() const;
+    // Множитель F разложения factorizeCameraMatrix
+    std::optional<cv::Matx33d> cameraMatrix() const;
+    // Мировых единиц на пиксел, 1 / F(0, 0) и 1 / F(1, 1)
+    std::optional<cv::Size2d> pixelSize() const;
+private:
+    // Сумма по кадрам F кадра, умноженного на число его точек
+    cv::Matx22d mCameraSum{};
+    cv::Matx22d mLastRotation{};
+    cv::Point2d mLastImageMean{};
+    cv::Point2d mLastWorldMean{};
+    size_t mFrames{};
+    size_t mPoints{};
+};
+
+}
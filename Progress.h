@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace camcalib {
+
+enum class CalibrationStage {
+    Edges,
+    Components,
+    Fit,
+    Solve
+};
+
+// Вызывается из рабочего потока в начале каждого этапа, false - операция отменена
+using ProgressCallback = std::function<bool(CalibrationStage)>;
+
+inline bool reportStage(const ProgressCallback& progress, CalibrationStage stage) {
+    return !progress || progress(stage);
+}
+
+// Признак отмены задания: задание отменено, когда запущено следующее
+class CancellationToken {
+public:
+    CancellationToken(std::shared_ptr<const std::atomic<uint64_t>> current, uint64_t generation)
+        : mCurrent{std::move(current)}, mGeneration{generation} {
+    }
+    bool isCancelled() const {
+        return mCurrent->load() != mGeneration;
+    }
+private:
+    std::shared_ptr<const std::atomic<uint64_t>> mCurrent;
+    uint64_t mGeneration;
+};
+
+// Счетчик поколений заданий одного владельца
+class JobGeneration {
+public:
+    CancellationToken next() {
+        return {mCurrent, ++*mCurrent};
+    }
+    void cancel() {
+        ++*mCurrent;
+    }
+private:
+    std::shared_ptr<std::atomic<uint64_t>> mCurrent{std::make_shared<std::atomic<uint64_t>>(0)};
+};
+
+}
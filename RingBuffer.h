@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <vector>
+
+namespace camcalib {
+
+// Кольцевой буфер без блокировок для одного производителя и одного потребителя.
+// push вызывается только из потока производителя, pop - только из потока потребителя.
+template<typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity)
+        : mSlots(std::max<size_t>(capacity, 1) + 1) {
+    }
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+    // false - буфер заполнен, значение не помещено
+    bool push(T value) {
+        auto tail = mTail.load(std::memory_order_relaxed);
+        auto next = increment(tail);
+        if(next == mHead.load(std::memory_order_acquire)) {
+            return false;
+        }
+        mSlots[tail] = std::move(value);
+        mTail.store(next, std::memory_order_release);
+        return true;
+    }
+    std::optional<T> pop() {
+        auto head = mHead.load(std::memory_order_relaxed);
+        if(head == mTail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        auto value = std::move(mSlots[head]);
+        mSlots[head] = T{};
+        mHead.store(increment(head), std::memory_order_release);
+        return value;
+    }
+    bool empty() const {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+    size_t capacity() const {
+        return mSlots.size() - 1;
+    }
+private:
+    size_t increment(size_t index) const {
+        return index + 1 == mSlots.size() ? 0 : index + 1;
+    }
+    std::vector<T> mSlots;
+    // Индексы разнесены по строкам кэша, чтобы потоки не делили одну строку
+    alignas(64) std::atomic<size_t> mHead{0};
+    alignas(64) std::atomic<size_t> mTail{0};
+};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Progress.h"
+#include <ceres/iteration_callback.h>
+
+namespace camcalib {
+
+// Прерывает решатель, если задание отменено
+class ProgressIterationCallback : public ceres::IterationCallback {
+public:
+    explicit ProgressIterationCallback(const ProgressCallback& progress)
+        : mProgress{progress} {
+    }
+    ceres::CallbackReturnType operator()(const ceres::IterationSummary&) override {
+        return reportStage(mProgress, CalibrationStage::Solve)
+            ? ceres::SOLVER_CONTINUE
+            : ceres::SOLVER_ABORT;
+    }
+private:
+    const ProgressCallback& mProgress;
+};
+
+}
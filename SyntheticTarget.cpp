@@ -0,0 +1,105 @@
+#include "SyntheticTarget.h"
+#include "Calibration.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+namespace camcalib {
+
+namespace {
+
+cv::Point2d apply(const cv::Matx23d& m, const cv::Point2d& p) {
+    return {m(0, 0) * p.x + m(0, 1) * p.y + m(0, 2),
+            m(1, 0) * p.x + m(1, 1) * p.y + m(1, 2)};
+}
+
+}
+
+SyntheticTarget renderSyntheticTarget(const SyntheticTargetParams& params) {
+    CV_Assert(!params.gridSize.empty() && params.pixelSize > 0.0 && params.supersampling > 0);
+    CV_Assert(params.dotRadius > 0.0 && params.dotRadius < 0.5 * params.gridStep);
+    const auto step = params.gridStep;
+    const auto extent = cv::Point2d(step * (params.gridSize.width - 1), step * (params.gridSize.height - 1));
+    const auto cosA = std::cos(params.rotation);
+    const auto sinA = std::sin(params.rotation);
+    auto imageSize = params.imageSize;
+    if(imageSize.empty()) {
+        auto width = std::abs(cosA) * extent.x + std::abs(sinA) * extent.y + 2.0 * step;
+        auto height = std::abs(sinA) * extent.x + std::abs(cosA) * extent.y + 2.0 * step;
+        imageSize = cv::Size(cvCeil(width / params.pixelSize), cvCeil(height / params.pixelSize));
+    }
+    // Центр изображения переходит в центр сетки
+    const auto s = params.pixelSize;
+    const auto imageCenter = cv::Point2d(0.5 * (imageSize.width - 1), 0.5 * (imageSize.height - 1));
+    const auto gridCenter = 0.5 * extent;
+    auto imageToWorld = cv::Matx23d(s * cosA, s * sinA, 0.0,
+                                    -s * sinA, s * cosA, 0.0);
+    imageToWorld(0, 2) = gridCenter.x - (imageToWorld(0, 0) * imageCenter.x + imageToWorld(0, 1) * imageCenter.y);
+    imageToWorld(1, 2) = gridCenter.y - (imageToWorld(1, 0) * imageCenter.x + imageToWorld(1, 1) * imageCenter.y);
+    cv::Matx23d worldToImage;
+    cv::invertAffineTransform(imageToWorld, worldToImage);
+
+    SyntheticTarget result;
+    result.imageToWorld = imageToWorld;
+    result.centersWorld = generatePointsGrid(params.gridSize, step);
+    const auto radiusPixels = static_cast<float>(params.dotRadius / s);
+    for(const auto& node: result.centersWorld) {
+        auto center = distortPoint(params.distortion, apply(worldToImage, node));
+        result.circlesImage.emplace_back(static_cast<float>(center.x), static_cast<float>(center.y), radiusPixels);
+    }
+
+    // Покрытие пиксела меткой: пикселы вдали от края метки не разбиваются на отсчеты
+    const auto margin = 2.0 * s;
+    const auto samples = params.supersampling;
+    const auto sampleWeight = 1.0f / (samples * samples);
+    auto distanceToDot = [&](const cv::Point2d& p) {
+        auto w = apply(imageToWorld, undistortPoint(params.distortion, p));
+        // Ближайший узел прямоугольной сетки - ближайший по каждой оси
+        auto col = std::clamp(cvRound(w.x / step), 0, params.gridSize.width - 1);
+        auto row = std::clamp(cvRound(w.y / step), 0, params.gridSize.height - 1);
+        auto delta = w - cv::Point2d(col * step, row * step);
+        return std::sqrt(delta.dot(delta));
+    };
+    cv::Mat intensity(imageSize, CV_32F);
+    std::vector<int> rows(imageSize.height);
+    std::iota(rows.begin(), rows.end(), 0);
+    const auto maxRadius2 = imageCenter.dot(imageCenter);
+    std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int y) {
+        auto dst = intensity.ptr<float>(y);
+        for(int x = 0; x < imageSize.width; x++) {
+            auto distance = distanceToDot(cv::Point2d(x, y));
+            auto coverage = 0.0f;
+            if(distance < params.dotRadius - margin) {
+                coverage = 1.0f;
+            } else if(distance <= params.dotRadius + margin) {
+                for(int sy = 0; sy < samples; sy++) {
+                    for(int sx = 0; sx < samples; sx++) {
+                        auto sample = cv::Point2d(x + (sx + 0.5) / samples - 0.5,
+                                                  y + (sy + 0.5) / samples - 0.5);
+                        coverage += distanceToDot(sample) <= params.dotRadius ? sampleWeight : 0.0f;
+                    }
+                }
+            }
+            auto value = params.background + (params.foreground - params.background) * coverage;
+            if(params.vignetting > 0.0 && maxRadius2 > 0.0) {
+                auto offset = cv::Point2d(x, y) - imageCenter;
+                value *= 1.0 - params.vignetting * offset.dot(offset) / maxRadius2;
+            }
+            dst[x] = static_cast<float>(value);
+        }
+    });
+    if(params.blurSigma > 0.0) {
+        cv::GaussianBlur(intensity, intensity, cv::Size{}, params.blurSigma);
+    }
+    if(params.noiseSigma > 0.0) {
+        cv::Mat noise(imageSize, CV_32F);
+        cv::RNG rng(params.seed);
+        rng.fill(noise, cv::RNG::NORMAL, 0.0, params.noiseSigma);
+        intensity += noise;
+    }
+    intensity.convertTo(result.image, CV_8U);
+    return result;
+}
+
+}
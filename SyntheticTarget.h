@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Distortion.h"
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace camcalib {
+
+struct SyntheticTargetParams {
+    cv::Size gridSize{10, 10};
+    // Шаг сетки и радиус метки в мировых единицах
+    double gridStep{1.0};
+    double dotRadius{0.25};
+    // Мировых единиц на пиксел
+    double pixelSize{0.02};
+    // Поворот сетки относительно осей изображения, рад
+    double rotation{0.0};
+    // Пустой размер - сетка с полями в один шаг
+    cv::Size imageSize{};
+    double background{200.0};
+    double foreground{40.0};
+    double blurSigma{1.0};
+    double noiseSigma{0.0};
+    // Относительное падение яркости в углах изображения
+    double vignetting{0.0};
+    LensDistortion distortion{};
+    int supersampling{4};
+    uint64_t seed{12345};
+};
+
+struct SyntheticTarget {
+    // CV_8U
+    cv::Mat image;
+    // Узлы generatePointsGrid(gridSize, gridStep)
+    std::vector<cv::Point2f> centersWorld;
+    // Точные изображения узлов с учетом дисторсии и радиус в пикселах, в порядке centersWorld
+    std::vector<cv::Vec3f> circlesImage;
+    // Неискаженные координаты изображения в мировые
+    cv::Matx23d imageToWorld;
+};
+
+// Метка рисуется по покрытию пиксела subsampling x subsampling отсчетами,
+// каждый отсчет переводится в мировые координаты моделью дисторсии, поэтому
+// истинные центры известны точно для любых параметров.
+SyntheticTarget renderSyntheticTarget(const SyntheticTargetParams& params);
+
+}
@@ -1,19 +1,41 @@
 #include "TargetImage.h"
 #include "Calibration.h"
+#include "DetectionCache.h"
 #include "Graphics.h"
-#include <opencv2/imgcodecs.hpp>
+#include "MappedImage.h"
+#include "AsyncJobs.h"
+#include "Trace.h"
 #include <QRectF>
 #include <QDebug>
 
+namespace {
+
+struct CalibrationJobResult {
+    std::vector<cv::Point2f> detectedGrid;
+    std::optional<cv::Matx33f> cameraMatrix;
+};
+
+}
+
 TargetImage::TargetImage(QObject *parent)
-    : QObject{parent}
-{}
+    : QObject{parent},
+    mJobs{new AsyncJobs{this}} {
+    connect(mJobs, &AsyncJobs::stageChanged, this, [this](camcalib::CalibrationStage stage){
+        emit progress(stageName(stage));
+    });
+    connect(mJobs, &AsyncJobs::finished, this, &TargetImage::finished);
+}
 
 void TargetImage::loadImage(QString filename) {
-    cv::Mat image = cv::imread(filename.toStdString(), cv::IMREAD_GRAYSCALE);
+    // PGM и raw отображаются в память, страницы читаются по мере обращения
+    cv::Mat image = camcalib::readGrayscaleImage(filename.toStdString());
     if(!image.empty()) {
+        mJobs->cancel();
         std::swap(mImage, image);
+        mDisplayCache.setImage(mImage);
+        mDetectionCache = std::make_shared<camcalib::DetectionCache>(mImage);
         mDetectedGridPoints.clear();
+        mGridOverlay.clear();
         mCameraMatrix.reset();
         mFilename = filename;
         emit changed();
@@ -23,23 +45,59 @@ void TargetImage::loadImage(QString filename) {
     }
 }
 
+void TargetImage::setFrame(cv::Mat image, QString name, std::vector<cv::Point2f> detectedGridPoints) {
+    mJobs->cancel();
+    std::swap(mImage, image);
+    mDisplayCache.setImage(mImage);
+    mDetectionCache = std::make_shared<camcalib::DetectionCache>(mImage);
+    std::swap(mDetectedGridPoints, detectedGridPoints);
+    mGridOverlay.setGridPoints(mDetectedGridPoints);
+    mCameraMatrix.reset();
+    mFilename = std::move(name);
+    emit changed();
+}
+
 void TargetImage::startCalibration(const CalibrationParams &params) {
-    auto detectedGrid = detectGridCenters(params.gridSize,
-                                   params.edgeStrength,
-                                   params.imageROI);
-    if(detectedGrid.empty()) {
-        emit error(tr("Ошибка поиска калибровочного шаблона"));
-        return;
-    }
-    auto generatedGrid = camcalib::generatePointsGrid(params.gridSize, params.gridStep);
-    auto cameraMatrix = camcalib::calibrate(detectedGrid, generatedGrid);
-    if(cameraMatrix) {
-        std::swap(detectedGrid, mDetectedGridPoints);
-        std::swap(cameraMatrix, mCameraMatrix);
-        emit changed();
-    } else {
-        emit error(tr("Ошибка вычисления матрицы камеры"));
-    }
+    // Изображение разделяется с заданием, загрузка нового его не затрагивает
+    mJobs->start([image = mImage, params, cache = mDetectionCache](const camcalib::ProgressCallback& progress) {
+        auto result = CalibrationJobResult{};
+        auto [detectedGrid, generatedGrid] = detectGridCorrespondences(image, params, progress, cache);
+        if(detectedGrid.empty() || !camcalib::reportStage(progress, camcalib::CalibrationStage::Solve)) {
+            return result;
+        }
+        result.cameraMatrix = camcalib::calibrate(detectedGrid, std::move(generatedGrid));
+        result.detectedGrid = std::move(detectedGrid);
+        return result;
+    }, [this](CalibrationJobResult result){
+        if(result.detectedGrid.empty()) {
+            emit error(tr("Ошибка поиска калибровочного шаблона"));
+        } else if(result.cameraMatrix) {
+            std::swap(result.detectedGrid, mDetectedGridPoints);
+            mGridOverlay.setGridPoints(mDetectedGridPoints);
+            std::swap(result.cameraMatrix, mCameraMatrix);
+            emit changed();
+        } else {
+            emit error(tr("Ошибка вычисления матрицы камеры"));
+        }
+    });
+}
+
+void TargetImage::startCircleDetection(camcalib::GridSearchParams searchParams) {
+    searchParams.cache = mDetectionCache;
+    mJobs->start([image = mImage, searchParams](const camcalib::ProgressCallback& progress) mutable {
+        searchParams.progress = progress;
+        return camcalib::findCirclesGrid(image, searchParams);
+    }, [this](std::vector<cv::Vec3f> circles){
+        emit circlesDetected(circles);
+    });
+}
+
+void TargetImage::cancel() {
+    mJobs->cancel();
+}
+
+bool TargetImage::isBusy() const {
+    return mJobs->isRunning();
 }
 
 QRectF TargetImage::getImageRect() const {
@@ -56,17 +114,19 @@ QString TargetImage::cameraMatrixToString() const {
 }
 
 void TargetImage::draw(const Graphics &graphics) const {
-    graphics.drawImage(mImage);
-    graphics.drawGridPoints(mDetectedGridPoints);
+    {
+        CAMCALIB_TRACE_SCOPE("drawImage");
+        graphics.drawImage(mDisplayCache.pixmapForScale(graphics.getScale()), getImageRect());
+    }
+    mGridOverlay.draw(graphics);
 }
 
-std::vector<cv::Point2f> TargetImage::detectGridCenters(const cv::Size &gridSize, double edgeStrength,
-                                                 const std::optional<cv::Rect> &imageROI) const {
-    auto searchParams = camcalib::GridSearchParams{edgeStrength, gridSize, imageROI};
+std::vector<cv::Point2f> TargetImage::detectGridCenters(camcalib::GridSearchParams searchParams) const {
+    searchParams.cache = mDetectionCache;
     return camcalib::findCirclesCentersGrid(mImage, searchParams);
 }
 
-std::vector<cv::Vec3f> TargetImage::detectGridCircles(const cv::Size &gridSize, double edgeStrength, const std::optional<cv::Rect> &imageROI) const {
-    auto searchParams = camcalib::GridSearchParams{edgeStrength, gridSize, imageROI};
+std::vector<cv::Vec3f> TargetImage::detectGridCircles(camcalib::GridSearchParams searchParams) const {
+    searchParams.cache = mDetectionCache;
     return camcalib::findCirclesGrid(mImage, searchParams);
 }
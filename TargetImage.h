@@ -1,25 +1,31 @@
 #pragma once
 
 #include <QObject>
+#include "CalibrationParams.h"
+#include "ImageDisplayCache.h"
+#include "OverlayLayer.h"
 #include <opencv2/core.hpp>
+#include <memory>
 #include <vector>
 #include <optional>
 
-struct CalibrationParams {
-    double edgeStrength;
-    double gridStep;
-    cv::Size gridSize;
-    std::optional<cv::Rect> imageROI;
-};
-
 class Graphics;
+class AsyncJobs;
 
 class TargetImage : public QObject {
     Q_OBJECT
 public:
     explicit TargetImage(QObject *parent = nullptr);
     void loadImage(QString filename);
+    // Кадр из конвейера захвата вместе с найденными на нем центрами
+    void setFrame(cv::Mat image, QString name, std::vector<cv::Point2f> detectedGridPoints);
+    // Поиск сетки и калибровка в пуле потоков, результат - сигналы changed или error.
+    // Новый запуск, загрузка изображения или кадра отменяют текущее задание.
     void startCalibration(const CalibrationParams& prams);
+    // Поиск окружностей в пуле потоков, результат - сигнал circlesDetected
+    void startCircleDetection(camcalib::GridSearchParams searchParams);
+    void cancel();
+    bool isBusy() const;
     auto empty() const {
         return mImage.empty();
     }
@@ -32,19 +38,32 @@ public:
     const auto& getFilename() const {
         return mFilename;
     }
+    // Промежуточные результаты поиска меток на текущем изображении
+    const auto& getDetectionCache() const {
+        return mDetectionCache;
+    }
     QRectF getImageRect() const;
     QString cameraMatrixToString() const;
     void draw(const Graphics& graphics) const;
-    std::vector<cv::Point2f> detectGridCenters(const cv::Size& gridSize, double edgeStrength,
-                                               const std::optional<cv::Rect>& imageROI) const;
-    std::vector<cv::Vec3f> detectGridCircles(const cv::Size& gridSize, double edgeStrength,
-                                             const std::optional<cv::Rect>& imageROI) const;
+    std::vector<cv::Point2f> detectGridCenters(camcalib::GridSearchParams searchParams) const;
+    std::vector<cv::Vec3f> detectGridCircles(camcalib::GridSearchParams searchParams) const;
 signals:      
     void changed();
     void error(const QString& message);
+    void circlesDetected(const std::vector<cv::Vec3f>& circles);
+    // Этап текущего задания
+    void progress(const QString& stage);
+    void finished();
 private:
+    AsyncJobs* mJobs{};
     QString mFilename;
     cv::Mat mImage;
+    // Уровни для отображения строятся при рисовании
+    mutable ImageDisplayCache mDisplayCache;
+    // Создается заново для каждого изображения, задания держат кэш своего изображения
+    std::shared_ptr<camcalib::DetectionCache> mDetectionCache;
     std::vector<cv::Point2f> mDetectedGridPoints;
+    // Кресты mDetectedGridPoints, перестраиваются вместе с ними
+    OverlayLayer mGridOverlay;
     std::optional<cv::Matx33f> mCameraMatrix{};
 };
@@ -0,0 +1,174 @@
+#include "Trace.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace camcalib::trace {
+
+namespace {
+
+// Около 10 МБ на поток
+constexpr size_t MaxEventsPerThread = 1 << 18;
+
+// Начало отсчета времени трассы
+const auto ProcessStart = Clock::now();
+
+struct Event {
+    const char* name;
+    Clock::time_point start;
+    Clock::duration duration;
+    double value;
+    bool isCounter;
+};
+
+// Каждый поток пишет в свой буфер, блокировка нужна только при чтении трассы
+struct ThreadBuffer {
+    std::mutex mutex;
+    std::vector<Event> events;
+    size_t dropped{};
+    uint32_t id{};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local auto buffer = [] {
+        auto result = std::make_shared<ThreadBuffer>();
+        auto& instance = registry();
+        std::lock_guard lock{instance.mutex};
+        result->id = static_cast<uint32_t>(instance.buffers.size() + 1);
+        instance.buffers.push_back(result);
+        return result;
+    }();
+    return *buffer;
+}
+
+void record(const Event& event) {
+    auto& buffer = threadBuffer();
+    std::lock_guard lock{buffer.mutex};
+    if(buffer.events.size() >= MaxEventsPerThread) {
+        ++buffer.dropped;
+        return;
+    }
+    buffer.events.push_back(event);
+}
+
+// Обход событий всех потоков
+template<typename Callable>
+void forEachEvent(Callable callable) {
+    auto& instance = registry();
+    std::lock_guard lock{instance.mutex};
+    for(const auto& buffer: instance.buffers) {
+        std::lock_guard bufferLock{buffer->mutex};
+        for(const auto& event: buffer->events) {
+            callable(*buffer, event);
+        }
+    }
+}
+
+void writeEscaped(std::ostream& os, const char* text) {
+    for(auto c = text; *c != '\0'; c++) {
+        if(*c == '"' || *c == '\\') {
+            os << '\\';
+        }
+        os << *c;
+    }
+}
+
+}
+
+void complete(const char* name, Clock::time_point start, Clock::time_point end) {
+    record({name, start, end - start, 0.0, false});
+}
+
+void counter(const char* name, double value) {
+    record({name, Clock::now(), Clock::duration::zero(), value, true});
+}
+
+std::vector<SummaryEntry> summary() {
+    std::map<std::string, SummaryEntry> entries;
+    forEachEvent([&](const ThreadBuffer&, const Event& event) {
+        auto& entry = entries[event.name];
+        auto value = event.isCounter
+            ? event.value
+            : std::chrono::duration<double, std::milli>(event.duration).count();
+        entry.isCounter = event.isCounter;
+        entry.count++;
+        entry.total += value;
+        entry.max = std::max(entry.max, value);
+        entry.last = value;
+    });
+    std::vector<SummaryEntry> result;
+    for(auto& [name, entry]: entries) {
+        entry.name = name;
+        result.push_back(std::move(entry));
+    }
+    std::sort(result.begin(), result.end(), [](const auto& e1, const auto& e2){
+        return e1.total > e2.total;
+    });
+    return result;
+}
+
+bool writeChromeTrace(const std::string& filename) {
+    std::ofstream os(filename);
+    if(!os) {
+        std::cerr << __FUNCTION__": can't open " << filename << std::endl;
+        return false;
+    }
+    const auto origin = ProcessStart;
+    auto microseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    auto first = true;
+    forEachEvent([&](const ThreadBuffer& buffer, const Event& event) {
+        os << (first ? "\n" : ",\n") << "{\"name\":\"";
+        writeEscaped(os, event.name);
+        os << "\",\"pid\":1,\"tid\":" << buffer.id
+           << ",\"ts\":" << microseconds(event.start - origin);
+        if(event.isCounter) {
+            os << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+        } else {
+            os << ",\"ph\":\"X\",\"dur\":" << microseconds(event.duration) << "}";
+        }
+        first = false;
+    });
+    os << "\n]}\n";
+    return static_cast<bool>(os);
+}
+
+void clear() {
+    auto& instance = registry();
+    std::lock_guard lock{instance.mutex};
+    for(const auto& buffer: instance.buffers) {
+        std::lock_guard bufferLock{buffer->mutex};
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+}
+
+size_t droppedEvents() {
+    auto& instance = registry();
+    std::lock_guard lock{instance.mutex};
+    size_t result = 0;
+    for(const auto& buffer: instance.buffers) {
+        std::lock_guard bufferLock{buffer->mutex};
+        result += buffer->dropped;
+    }
+    return result;
+}
+
+}
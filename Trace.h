@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Трассировка этапов: CAMCALIB_TRACE_SCOPE("имя") - время до конца области видимости,
+// CAMCALIB_TRACE_COUNTER("имя", значение) - счетчик. Имена должны быть строковыми литералами.
+// Без CAMCALIB_ENABLE_TRACING макросы ничего не делают и трасса пуста.
+#ifdef CAMCALIB_ENABLE_TRACING
+#define CAMCALIB_TRACE_CONCAT_IMPL(a, b) a##b
+#define CAMCALIB_TRACE_CONCAT(a, b) CAMCALIB_TRACE_CONCAT_IMPL(a, b)
+#define CAMCALIB_TRACE_SCOPE(name) ::camcalib::trace::Scope CAMCALIB_TRACE_CONCAT(traceScope, __LINE__){name}
+#define CAMCALIB_TRACE_COUNTER(name, value) ::camcalib::trace::counter(name, static_cast<double>(value))
+#else
+#define CAMCALIB_TRACE_SCOPE(name) ((void)0)
+#define CAMCALIB_TRACE_COUNTER(name, value) ((void)0)
+#endif
+
+namespace camcalib::trace {
+
+constexpr bool isCompiledIn() {
+#ifdef CAMCALIB_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+using Clock = std::chrono::steady_clock;
+
+void complete(const char* name, Clock::time_point start, Clock::time_point end);
+void counter(const char* name, double value);
+
+class Scope {
+public:
+    explicit Scope(const char* name)
+        : mName{name}, mStart{Clock::now()} {
+    }
+    ~Scope() {
+        complete(mName, mStart, Clock::now());
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    const char* mName;
+    Clock::time_point mStart;
+};
+
+struct SummaryEntry {
+    std::string name;
+    bool isCounter{false};
+    size_t count{};
+    // Для областей - миллисекунды, для счетчиков - значения
+    double total{};
+    double max{};
+    double last{};
+};
+
+// Сводка по именам в порядке убывания total
+std::vector<SummaryEntry> summary();
+// Формат Chrome trace (chrome://tracing, ui.perfetto.dev)
+bool writeChromeTrace(const std::string& filename);
+void clear();
+// События сверх лимита буфера не записываются
+size_t droppedEvents();
+
+}
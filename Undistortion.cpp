@@ -0,0 +1,61 @@
+#include "Undistortion.h"
+#include "Trace.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+namespace camcalib {
+
+UndistortionMap makeUndistortionMap(const LensDistortion& distortion, cv::Size imageSize, int step) {
+    CAMCALIB_TRACE_SCOPE("makeUndistortionMap");
+    CV_Assert(!imageSize.empty() && step > 0);
+    // Узлы покрывают изображение с запасом в один шаг
+    const auto nodes = cv::Size((imageSize.width - 1) / step + 2, (imageSize.height - 1) / step + 2);
+    cv::Mat coarse(nodes, CV_32FC2);
+    std::vector<int> rows(std::max(nodes.height, imageSize.height));
+    std::iota(rows.begin(), rows.end(), 0);
+    std::for_each(std::execution::par, rows.begin(), rows.begin() + nodes.height, [&](int y) {
+        auto dst = coarse.ptr<cv::Point2f>(y);
+        for(int x = 0; x < nodes.width; x++) {
+            dst[x] = distortPoint(distortion, cv::Point2d(x * step, y * step));
+        }
+    });
+
+    UndistortionMap result;
+    result.imageSize = imageSize;
+    result.map1.create(imageSize, CV_16SC2);
+    result.map2.create(imageSize, CV_16UC1);
+    const auto scale = 1.0f / step;
+    std::for_each(std::execution::par, rows.begin(), rows.begin() + imageSize.height, [&](int y) {
+        const auto row = y / step;
+        const auto ty = (y - row * step) * scale;
+        auto top = coarse.ptr<cv::Point2f>(row);
+        auto bottom = coarse.ptr<cv::Point2f>(row + 1);
+        auto dst1 = result.map1.ptr<cv::Vec2s>(y);
+        auto dst2 = result.map2.ptr<ushort>(y);
+        for(int x = 0; x < imageSize.width; x++) {
+            const auto col = x / step;
+            const auto tx = (x - col * step) * scale;
+            auto p = (1.0f - ty) * ((1.0f - tx) * top[col] + tx * top[col + 1]) +
+                     ty * ((1.0f - tx) * bottom[col] + tx * bottom[col + 1]);
+            auto ix = cvRound(p.x * cv::INTER_TAB_SIZE);
+            auto iy = cvRound(p.y * cv::INTER_TAB_SIZE);
+            dst1[x] = cv::Vec2s(cv::saturate_cast<short>(ix >> cv::INTER_BITS),
+                                cv::saturate_cast<short>(iy >> cv::INTER_BITS));
+            dst2[x] = static_cast<ushort>((iy & (cv::INTER_TAB_SIZE - 1)) * cv::INTER_TAB_SIZE +
+                                          (ix & (cv::INTER_TAB_SIZE - 1)));
+        }
+    });
+    return result;
+}
+
+void undistortImage(const cv::Mat& src, cv::Mat& dst, const UndistortionMap& map) {
+    CAMCALIB_TRACE_SCOPE("undistortImage");
+    CV_Assert(src.size() == map.imageSize && src.channels() == 1);
+    CV_Assert(src.depth() == CV_8U || src.depth() == CV_16U);
+    // Ветвь remap для таблиц фиксированной точки векторизована и делит строки между потоками
+    cv::remap(src, dst, map.map1, map.map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Distortion.h"
+#include <opencv2/core.hpp>
+
+namespace camcalib {
+
+// Таблица исправления дисторсии в формате фиксированной точки cv::convertMaps:
+// map1 - CV_16SC2 целые координаты исходного пиксела, map2 - CV_16UC1 индекс
+// интерполяции (cv::INTER_BITS бит дробной части по каждой оси)
+struct UndistortionMap {
+    cv::Size imageSize;
+    cv::Mat map1;
+    cv::Mat map2;
+};
+
+// Обратная задача (distortPoint) решается в узлах с шагом step пикселов,
+// между узлами координаты интерполируются билинейно
+UndistortionMap makeUndistortionMap(const LensDistortion& distortion, cv::Size imageSize, int step = 16);
+
+// src - CV_8U или CV_16U размера map.imageSize, dst переиспользуется между кадрами
+void undistortImage(const cv::Mat& src, cv::Mat& dst, const UndistortionMap& map);
+
+}
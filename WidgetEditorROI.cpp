@@ -9,6 +9,10 @@ WidgetEditorROI::WidgetEditorROI(QWidget *parent)
         connect(spinBoxROI, &QSpinBox::valueChanged,
                 this, &WidgetEditorROI::roiChanged);
     }
+    connect(ui->pushButtonAddExcluded, &QPushButton::clicked,
+            this, &WidgetEditorROI::addExcludedRegion);
+    connect(ui->pushButtonRemoveExcluded, &QPushButton::clicked,
+            this, &WidgetEditorROI::removeExcludedRegion);
 }
 
 WidgetEditorROI::~WidgetEditorROI() {
@@ -28,3 +32,34 @@ std::optional<cv::Rect> WidgetEditorROI::getROI(const cv::Size &imageSize) const
     }
     return std::nullopt;
 }
+
+const std::vector<cv::Rect> &WidgetEditorROI::getExcludedRegions() const {
+    return mExcludedRegions;
+}
+
+void WidgetEditorROI::addExcludedRegion() {
+    auto region = cv::Rect(ui->spinBoxExcludedX->value(),
+                           ui->spinBoxExcludedY->value(),
+                           ui->spinBoxExcludedWidth->value(),
+                           ui->spinBoxExcludedHeight->value());
+    if(region.empty()) {
+        return;
+    }
+    mExcludedRegions.push_back(region);
+    ui->listWidgetExcluded->addItem(QString("%1, %2, %3x%4")
+                                        .arg(region.x)
+                                        .arg(region.y)
+                                        .arg(region.width)
+                                        .arg(region.height));
+    emit roiChanged();
+}
+
+void WidgetEditorROI::removeExcludedRegion() {
+    auto row = ui->listWidgetExcluded->currentRow();
+    if(row < 0 || row >= static_cast<int>(mExcludedRegions.size())) {
+        return;
+    }
+    mExcludedRegions.erase(mExcludedRegions.begin() + row);
+    delete ui->listWidgetExcluded->takeItem(row);
+    emit roiChanged();
+}
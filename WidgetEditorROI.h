@@ -3,6 +3,7 @@
 #include <QGroupBox>
 #include <opencv2/core/types.hpp>
 #include <optional>
+#include <vector>
 
 namespace Ui {
 class WidgetEditorROI;
@@ -16,6 +17,10 @@ public:
     explicit WidgetEditorROI(QWidget *parent = nullptr);
     ~WidgetEditorROI();
     std::optional<cv::Rect> getROI(const cv::Size& imageSize) const;
+    const std::vector<cv::Rect>& getExcludedRegions() const;
 private:
+    void addExcludedRegion();
+    void removeExcludedRegion();
     Ui::WidgetEditorROI *ui;
+    std::vector<cv::Rect> mExcludedRegions;
 };
@@ -5,8 +5,34 @@
 #include "Graphics.h"
 #include <QFileDialog>
 #include <QPaintEvent>
-#include "OpticalCenterCostFunction.h"
-#include <ceres/ceres.h>
+#include "OpticalCenter.h"
+#include "AsyncJobs.h"
+#include "MappedImage.h"
+#include "ZoomSweep.h"
+#include "Trace.h"
+#include <QTimer>
+#include <mutex>
+
+// Период опроса состояния серии увеличений
+constexpr auto SweepPollInterval = 20;
+
+// Состояние слежения после последнего обработанного кадра
+struct SweepSnapshot {
+    cv::Mat image;
+    size_t index{};
+    std::vector<cv::Vec3f> circles;
+    std::optional<camcalib::OpticalCenterSolution> solution;
+    size_t frames{};
+    size_t lostFrames{};
+};
+
+// Слежение выполняется только в задании, под блокировкой публикуется его снимок
+struct WidgetOpticalCenterSearch::SweepState {
+    std::mutex mutex;
+    SweepSnapshot snapshot;
+    // Увеличивается с каждым опубликованным снимком
+    size_t version{};
+};
 
 WidgetOpticalCenterSearch::WidgetOpticalCenterSearch(CameraModel *cameraModel, QWidget *parent)
     : QWidget(parent),
@@ -27,18 +53,21 @@ bool WidgetOpticalCenterSearch::eventFilter(QObject *watched, QEvent *event) {
     if(watched != ui->labelImage || event->type() != QEvent::Paint) {
         return QWidget::eventFilter(watched, event);;
     }
-    auto dstRect = static_cast<QPaintEvent*>(event)->rect();
+    CAMCALIB_TRACE_SCOPE("WidgetOpticalCenterSearch::paint");
+    // Вид строится по всей метке, рисуется только перерисовываемая часть
+    auto exposedRect = static_cast<QPaintEvent*>(event)->rect();
     QPainter painter(ui->labelImage);
-    painter.fillRect(dstRect, QColor(45, 46, 47));
+    painter.fillRect(exposedRect, QColor(45, 46, 47));
     if(!mTargetImage->empty()) {
-        Graphics graphics{painter, dstRect, mTargetImage->getImageRect()};
+        Graphics graphics{painter, ui->labelImage->rect(), mTargetImage->getImageRect(), exposedRect};
         mTargetImage->draw(graphics);
         if(auto roi = ui->widgetROI->getROI(mTargetImage->getImage().size())) {
             graphics.drawImageROI(*roi);
         }
-        for(const auto& circle: mDetectedCircles) {
-            graphics.drawCircle(circle);
+        for(const auto& region: ui->widgetROI->getExcludedRegions()) {
+            graphics.drawExcludedRegion(region);
         }
+        mCirclesOverlay.draw(graphics);
     }
     return false;
 }
@@ -54,10 +83,25 @@ void WidgetOpticalCenterSearch::setupWidgets() {
     connect(ui->pushButtonAddToCameraModel, &QPushButton::clicked,
             this, &WidgetOpticalCenterSearch::addOpticalCenterToModel);
     connect(ui->widgetROI, &WidgetEditorROI::roiChanged,
-            ui->labelImage, QOverload<>::of(&QLabel::update));
+            this, &WidgetOpticalCenterSearch::updateRegionsOverlay);
+    connect(ui->pushButtonPlaySweep, &QPushButton::toggled, this, [this](bool checked){
+        if(checked) {
+            startSweep();
+        } else {
+            stopSweep();
+        }
+    });
+    mSweepJobs = new AsyncJobs{this};
+    mSweepTimer = new QTimer(this);
+    connect(mSweepTimer, &QTimer::timeout,
+            this, &WidgetOpticalCenterSearch::pollSweep);
     connect(ui->pushButtonClear, &QPushButton::clicked, this, [this]{
+        ui->pushButtonPlaySweep->setChecked(false);
+        mSweepState.reset();
+        mTargetImage->cancel();
         mOpticalCenter.reset();
         mDetectedCircles.clear();
+        mCirclesOverlay.clear();
         ui->textEditLog->clear();
         update();
     });
@@ -69,6 +113,12 @@ void WidgetOpticalCenterSearch::setupTargetImage() {
             this, &WidgetOpticalCenterSearch::error);
     connect(mTargetImage, &TargetImage::changed,
             this, &WidgetOpticalCenterSearch::onNewImage);
+    connect(mTargetImage, &TargetImage::circlesDetected,
+            this, &WidgetOpticalCenterSearch::addTrackedCircle);
+    connect(mTargetImage, &TargetImage::progress,
+            ui->textEditLog, &QTextEdit::setText);
+    connect(mTargetImage, &TargetImage::finished,
+            this, &WidgetOpticalCenterSearch::updateWidgets);
 }
 
 void WidgetOpticalCenterSearch::updateWidgets() {
@@ -82,20 +132,38 @@ void WidgetOpticalCenterSearch::updateWidgets() {
 
 void WidgetOpticalCenterSearch::loadImage() {
     static auto dir = QString{};
-    auto filename = QFileDialog::getOpenFileName(this, tr("Открыть файл"), dir, tr("Изображения (*.bmp *.jpg *.png)"));
+    auto filename = QFileDialog::getOpenFileName(this, tr("Открыть файл"), dir, tr("Изображения (*.bmp *.jpg *.png *.tif *.pgm *.raw)"));
     dir = QFileInfo(filename).dir().path();
     if (!filename.isEmpty()) {
         mTargetImage->loadImage(std::move(filename));
     }    
 }
 
+camcalib::GridSearchParams WidgetOpticalCenterSearch::makeSearchParams() const {
+    auto searchParams = camcalib::GridSearchParams{};
+    searchParams.edgeStrength = 50.0;
+    searchParams.gridSize = cv::Size{1, 1};
+    if(!mTargetImage->empty()) {
+        searchParams.imageROI = ui->widgetROI->getROI(mTargetImage->getImage().size());
+    }
+    searchParams.excludedRegions = ui->widgetROI->getExcludedRegions();
+    return searchParams;
+}
+
 void WidgetOpticalCenterSearch::findTrackedCircle() {
-    auto imageROI = ui->widgetROI->getROI(mTargetImage->getImage().size());
-    auto circles = mTargetImage->detectGridCircles(cv::Size{1, 1}, 50.0, imageROI);
+    mTargetImage->startCircleDetection(makeSearchParams());
+}
+
+void WidgetOpticalCenterSearch::addTrackedCircle(const std::vector<cv::Vec3f>& circles) {
     if(!circles.empty()) {
         mDetectedCircles.push_back(circles.back());
-        std::cout << __FUNCTION__ << mDetectedCircles.back() << std::endl;
-    }    
+        mCirclesOverlay.setCircles(mDetectedCircles);
+        // Решение занимает микросекунды и пересчитывается с каждой новой окружностью
+        if(mDetectedCircles.size() >= 2) {
+            calculateOpticalCenter();
+            return;
+        }
+    }
     updateWidgets();
 }
 
@@ -104,35 +172,14 @@ void WidgetOpticalCenterSearch::calculateOpticalCenter() {
         emit error(tr("Необходимо добавить хотя бы 2 окружности"));
         return;
     }
-    ceres::Problem problem;
-    auto refCircle = mDetectedCircles.front();
-    std::vector<double> params(2 + 2 * (mDetectedCircles.size() - 1));
-    params[0] = refCircle[0];
-    params[1] = refCircle[1];
-    for(size_t i = 1; i < mDetectedCircles.size(); i++) {
-        auto circle = mDetectedCircles[i];
-        // Начальная оценка радиуса
-        params[2] = circle[2] / refCircle[2];
-        params[3] = params[2];
-        auto costs = makeOpticalCenterCostFunctions(circle, refCircle, i, 10);
-        for(auto cost: costs) {
-            auto costAutoDiff = new ceres::AutoDiffCostFunction<OpticalCenterCostFunction, 2, 4>(cost);
-            problem.AddResidualBlock(costAutoDiff, nullptr, params.data());
-        }
-    }
-    ceres::Solver::Options options;
-    options.linear_solver_type = ceres::DENSE_QR;
-    options.minimizer_progress_to_stdout = true;
-    ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
-    if(summary.IsSolutionUsable()) {
-        std::ostringstream os;
-        os << summary.BriefReport() << std::endl;
-        os << cv::Mat{params} << std::endl;
-        ui->textEditLog->setText(QString::fromStdString(os.str()));
-        mOpticalCenter.emplace(params[0], params[1]);
-        updateWidgets();
+    if(auto solution = camcalib::findOpticalCenter(mDetectedCircles)) {
+        ui->textEditLog->setText(QString::fromStdString(solution->report));
+        mOpticalCenter = solution->center;
+    } else {
+        mOpticalCenter.reset();
+        emit error(tr("Ошибка вычисления оптического центра"));
     }
+    updateWidgets();
 }
 
 void WidgetOpticalCenterSearch::addOpticalCenterToModel() {
@@ -141,6 +188,112 @@ void WidgetOpticalCenterSearch::addOpticalCenterToModel() {
     }
 }
 
+void WidgetOpticalCenterSearch::startSweep() {
+    static auto dir = QString{};
+    dir = QFileDialog::getExistingDirectory(this, tr("Каталог серии увеличений"), dir);
+    auto entries = QDir(dir).entryInfoList({"*.bmp", "*.jpg", "*.png", "*.tif", "*.tiff", "*.pgm", "*.raw"},
+                                           QDir::Files, QDir::Name);
+    if(dir.isEmpty() || entries.isEmpty()) {
+        ui->pushButtonPlaySweep->setChecked(false);
+        if(!dir.isEmpty()) {
+            emit error(tr("В каталоге %1 нет изображений").arg(dir));
+        }
+        return;
+    }
+    std::vector<std::string> files;
+    for(const auto& entry: entries) {
+        files.push_back(entry.filePath().toStdString());
+    }
+    mTargetImage->cancel();
+    mDetectedCircles.clear();
+    mCirclesOverlay.clear();
+    mOpticalCenter.reset();
+    auto params = camcalib::ZoomSweepParams{};
+    params.search = makeSearchParams();
+    mSweepState = std::make_shared<SweepState>();
+    mShownSweepVersion = 0;
+    // Кадры обрабатываются все и по порядку: каждый следующий предсказывается по предыдущему
+    mSweepJobs->start([files = std::move(files), params, state = mSweepState](const camcalib::ProgressCallback& progress) {
+        camcalib::ZoomSweepTracker tracker{params};
+        for(size_t index = 0; index < files.size(); index++) {
+            if(!camcalib::reportStage(progress, camcalib::CalibrationStage::Edges)) {
+                return false;
+            }
+            auto image = camcalib::readGrayscaleImage(files[index]);
+            if(image.empty()) {
+                continue;
+            }
+            tracker.addFrame(image);
+            auto snapshot = SweepSnapshot{std::move(image), index, tracker.getCircles(), tracker.getSolution(),
+                                          tracker.getFrameCount(), tracker.getLostFrames()};
+            std::lock_guard lock{state->mutex};
+            state->snapshot = std::move(snapshot);
+            state->version++;
+        }
+        return true;
+    }, [this](bool) {
+        pollSweep();
+        ui->pushButtonPlaySweep->setChecked(false);
+    });
+    mSweepTimer->start(SweepPollInterval);
+}
+
+void WidgetOpticalCenterSearch::stopSweep() {
+    mSweepTimer->stop();
+    mSweepJobs->cancel();
+    pollSweep();
+}
+
+void WidgetOpticalCenterSearch::pollSweep() {
+    if(!mSweepState) {
+        return;
+    }
+    SweepSnapshot snapshot;
+    {
+        std::lock_guard lock{mSweepState->mutex};
+        if(mSweepState->version == mShownSweepVersion) {
+            return;
+        }
+        mShownSweepVersion = mSweepState->version;
+        snapshot = mSweepState->snapshot;
+    }
+    auto name = tr("Кадр %1").arg(static_cast<qulonglong>(snapshot.index));
+    mTargetImage->setFrame(std::move(snapshot.image), name, {});
+    updateSweepSolution(snapshot);
+}
+
+void WidgetOpticalCenterSearch::updateSweepSolution(const SweepSnapshot& snapshot) {
+    // Окружности в решении только добавляются
+    if(snapshot.circles.size() != mDetectedCircles.size()) {
+        mDetectedCircles = snapshot.circles;
+        mCirclesOverlay.setCircles(mDetectedCircles);
+    }
+    auto log = tr("Кадров: %1, метка потеряна: %2, окружностей в решении: %3")
+                   .arg(static_cast<qulonglong>(snapshot.frames))
+                   .arg(static_cast<qulonglong>(snapshot.lostFrames))
+                   .arg(static_cast<qulonglong>(mDetectedCircles.size()));
+    if(snapshot.solution) {
+        mOpticalCenter = snapshot.solution->center;
+        log += "\n" + QString::fromStdString(snapshot.solution->report);
+    }
+    ui->textEditLog->setText(log);
+    updateWidgets();
+}
+
+void WidgetOpticalCenterSearch::updateRegionsOverlay() {
+    if(mTargetImage->empty()) {
+        return;
+    }
+    auto bounds = Graphics::regionsBounds(ui->widgetROI->getROI(mTargetImage->getImage().size()),
+                                          ui->widgetROI->getExcludedRegions());
+    // Перерисовываются старое и новое положения рамок
+    auto dstRect = ui->labelImage->rect();
+    auto srcRect = mTargetImage->getImageRect();
+    ui->labelImage->update(Graphics::mapToView(dstRect, srcRect, bounds)
+                               .united(Graphics::mapToView(dstRect, srcRect, mRegionsBounds)));
+    mRegionsBounds = bounds;
+}
+
 void WidgetOpticalCenterSearch::onNewImage() {    
     updateWidgets();
     ui->labelImage->update();
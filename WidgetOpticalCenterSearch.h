@@ -1,14 +1,23 @@
 #pragma once
 
+#include "OverlayLayer.h"
 #include <QWidget>
 #include <opencv2/core/types.hpp>
+#include <memory>
 
 namespace Ui {
 class WidgetOpticalCenterSearch;
 }
 
+class AsyncJobs;
 class CameraModel;
 class TargetImage;
+class QTimer;
+struct SweepSnapshot;
+
+namespace camcalib {
+struct GridSearchParams;
+}
 
 class WidgetOpticalCenterSearch : public QWidget {
     Q_OBJECT
@@ -26,12 +35,29 @@ private:
     void updateWidgets();
     void loadImage();
     void findTrackedCircle();
+    void addTrackedCircle(const std::vector<cv::Vec3f>& circles);
     void calculateOpticalCenter();
     void addOpticalCenterToModel();
     void onNewImage();    
+    void startSweep();
+    void stopSweep();
+    void pollSweep();
+    void updateSweepSolution(const SweepSnapshot& snapshot);
+    void updateRegionsOverlay();
+    camcalib::GridSearchParams makeSearchParams() const;
     Ui::WidgetOpticalCenterSearch *ui;
     CameraModel* mCameraModel{};
     TargetImage* mTargetImage{};
     std::optional<cv::Point2d> mOpticalCenter{};
     std::vector<cv::Vec3f> mDetectedCircles{};
+    OverlayLayer mCirclesOverlay;
+    // Рамки ROI и исключенных областей при последнем изменении, координаты изображения
+    QRectF mRegionsBounds;
+    // Серия увеличений: кадры читаются и отслеживаются в одном задании,
+    // интерфейс по таймеру показывает последний опубликованный снимок
+    struct SweepState;
+    std::shared_ptr<SweepState> mSweepState;
+    size_t mShownSweepVersion{};
+    AsyncJobs* mSweepJobs{};
+    QTimer* mSweepTimer{};
 };
@@ -2,10 +2,23 @@
 #include "ui_WidgetPixelSizeCalibration.h"
 #include "CameraModel.h"
 #include "TargetImage.h"
+#include "AsyncJobs.h"
+#include "DistortionCalibration.h"
+#include "MappedImage.h"
 #include "Graphics.h"
+#include "FramePipeline.h"
+#include "GridTracker.h"
+#include "Trace.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QPaintEvent>
+#include <QTimer>
+
+// Частота воспроизведения каталога и период опроса результатов конвейера
+constexpr auto PlaybackFps = 25.0;
+constexpr auto PipelinePollInterval = 20;
+// Пауза после последнего изменения параметров перед запуском предпросмотра, мс
+constexpr auto PreviewDelay = 300;
 
 WidgetPixelSizeCalibration::WidgetPixelSizeCalibration(CameraModel *cameraModel, QWidget *parent)
     : QWidget(parent),
@@ -19,6 +32,7 @@ WidgetPixelSizeCalibration::WidgetPixelSizeCalibration(CameraModel *cameraModel,
 }
 
 WidgetPixelSizeCalibration::~WidgetPixelSizeCalibration() {
+    mPipeline.reset();
     delete ui;
 }
 
@@ -28,6 +42,21 @@ void WidgetPixelSizeCalibration::setupTargetImage() {
             this, &WidgetPixelSizeCalibration::error);
     connect(mTargetImage, &TargetImage::changed,
             this, &WidgetPixelSizeCalibration::updateWidgets);
+    // Этапы калибровки выводятся в журнал до завершения или отмены задания
+    connect(mTargetImage, &TargetImage::progress,
+            ui->textEditLog, &QTextEdit::setText);
+    connect(mTargetImage, &TargetImage::finished,
+            this, &WidgetPixelSizeCalibration::updateWidgets);
+    mDistortionJobs = new AsyncJobs{this};
+    connect(mDistortionJobs, &AsyncJobs::stageChanged, this, [this](camcalib::CalibrationStage stage){
+        ui->textEditLog->setText(tr("Дисторсия: %1").arg(stageName(stage)));
+    });
+    connect(mDistortionJobs, &AsyncJobs::finished, this, [this]{
+        ui->pushButtonDistortion->setEnabled(true);
+    });
+    mPreviewJobs = new AsyncJobs{this};
+    connect(mTargetImage, &TargetImage::changed,
+            this, &WidgetPixelSizeCalibration::schedulePreview);
 }
 
 void WidgetPixelSizeCalibration::setupWidgets() {
@@ -35,16 +64,45 @@ void WidgetPixelSizeCalibration::setupWidgets() {
             this, &WidgetPixelSizeCalibration::loadImageFromFile);
     connect(ui->pushButtonCalc, &QPushButton::clicked,
             this, &WidgetPixelSizeCalibration::startCalibration);
-    connect(ui->widgetEditorROI, &WidgetEditorROI::roiChanged, this,
-            QOverload<>::of(&WidgetPixelSizeCalibration::update));
+    connect(ui->widgetEditorROI, &WidgetEditorROI::roiChanged,
+            this, &WidgetPixelSizeCalibration::updateRegionsOverlay);
+    mPreviewTimer = new QTimer(this);
+    mPreviewTimer->setSingleShot(true);
+    mPreviewTimer->setInterval(PreviewDelay);
+    connect(mPreviewTimer, &QTimer::timeout,
+            this, &WidgetPixelSizeCalibration::startPreview);
+    connect(ui->checkBoxPreview, &QCheckBox::toggled,
+            this, &WidgetPixelSizeCalibration::schedulePreview);
+    connect(ui->widgetEditorROI, &WidgetEditorROI::roiChanged,
+            this, &WidgetPixelSizeCalibration::schedulePreview);
+    for(auto spinBox: {ui->spinBoxEdgeStrength, ui->spinBoxGridWidth, ui->spinBoxGridHeight}) {
+        connect(spinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+                this, &WidgetPixelSizeCalibration::schedulePreview);
+    }
+    connect(ui->comboBoxFitMethod, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &WidgetPixelSizeCalibration::schedulePreview);
+    connect(ui->checkBoxPartialGrid, &QCheckBox::toggled,
+            this, &WidgetPixelSizeCalibration::schedulePreview);
     connect(ui->pushButtonAddToModel, &QPushButton::clicked,
             this, &WidgetPixelSizeCalibration::addCalibrationToModel);
+    connect(ui->pushButtonDistortion, &QPushButton::clicked,
+            this, &WidgetPixelSizeCalibration::startDistortionCalibration);
     connect(ui->lineEditCalibrationName, &QLineEdit::textChanged, this,
             [this](const QString& text){
                 auto hasCameraMatrix = mTargetImage->getCameraMatrix().has_value();
                 auto hasName = !text.isEmpty();
                 ui->pushButtonAddToModel->setEnabled(hasCameraMatrix && hasName);
             });
+    connect(ui->pushButtonPlayDirectory, &QPushButton::toggled, this, [this](bool checked){
+        if(checked) {
+            startPlayback();
+        } else {
+            stopPlayback();
+        }
+    });
+    mPipelineTimer = new QTimer(this);
+    connect(mPipelineTimer, &QTimer::timeout,
+            this, &WidgetPixelSizeCalibration::pollPipeline);
     ui->labelImage->installEventFilter(this);
     ui->pushButtonAddToModel->setEnabled(false);
 }
@@ -57,10 +115,14 @@ CalibrationParams WidgetPixelSizeCalibration::collectCalibrationParams() const {
         ui->spinBoxGridHeight->value()
     };
     result.gridStep = ui->spinBoxGridDist->value();
+    result.pyramidLevels = ui->spinBoxPyramidLevels->value();
+    result.fitMethod = static_cast<camcalib::CircleFitMethod>(ui->comboBoxFitMethod->currentIndex());
+    result.partialGrid = ui->checkBoxPartialGrid->isChecked();
     if(!mTargetImage->empty()) {
         auto size = mTargetImage->getImage().size();
         result.imageROI = ui->widgetEditorROI->getROI(size);
     }
+    result.excludedRegions = ui->widgetEditorROI->getExcludedRegions();
     return result;
 }
 
@@ -76,13 +138,108 @@ void WidgetPixelSizeCalibration::updateWidgets() {
 
 void WidgetPixelSizeCalibration::loadImageFromFile() {
     static auto dir = QString{};
-    auto filename = QFileDialog::getOpenFileName(this, tr("Открыть файл"), dir, tr("Изображения (*.bmp *jpg *png)"));
+    auto filename = QFileDialog::getOpenFileName(this, tr("Открыть файл"), dir, tr("Изображения (*.bmp *.jpg *.png *.tif *.pgm *.raw)"));
     dir = QFileInfo(filename).dir().path();
     if (!filename.isEmpty()) {
+        ui->pushButtonPlayDirectory->setChecked(false);
         mTargetImage->loadImage(std::move(filename));
     }
 }
 
+void WidgetPixelSizeCalibration::startPlayback() {
+    static auto dir = QString{};
+    dir = QFileDialog::getExistingDirectory(this, tr("Каталог кадров"), dir);
+    auto entries = QDir(dir).entryInfoList({"*.bmp", "*.jpg", "*.png", "*.tif", "*.tiff", "*.pgm", "*.raw"},
+                                           QDir::Files, QDir::Name);
+    if(dir.isEmpty() || entries.isEmpty()) {
+        ui->pushButtonPlayDirectory->setChecked(false);
+        if(!dir.isEmpty()) {
+            emit error(tr("В каталоге %1 нет изображений").arg(dir));
+        }
+        return;
+    }
+    std::vector<std::string> files;
+    for(const auto& entry: entries) {
+        files.push_back(entry.filePath().toStdString());
+    }
+    camcalib::TrackingParams trackingParams;
+    trackingParams.search = makeGridSearchParams(collectCalibrationParams());
+    // Состояние слежения принадлежит потоку поиска
+    auto tracker = std::make_shared<camcalib::GridTracker>(trackingParams);
+    auto detector = [tracker](const cv::Mat& image) {
+        return tracker->track(image);
+    };
+    auto source = std::make_unique<camcalib::DirectoryFrameSource>(std::move(files), PlaybackFps, true);
+    mPipeline = std::make_unique<camcalib::FramePipeline>(std::move(source), detector);
+    mPipeline->start();
+    mPipelineTimer->start(PipelinePollInterval);
+    schedulePreview();
+}
+
+void WidgetPixelSizeCalibration::stopPlayback() {
+    mPipelineTimer->stop();
+    mPipeline.reset();
+    schedulePreview();
+}
+
+void WidgetPixelSizeCalibration::pollPipeline() {
+    if(!mPipeline) {
+        return;
+    }
+    if(auto result = mPipeline->takeLatestResult()) {
+        std::vector<cv::Point2f> centers;
+        for(const auto& circle: result->circles) {
+            centers.emplace_back(circle[0], circle[1]);
+        }
+        auto stats = mPipeline->getStatistics();
+        auto name = tr("Кадр %1: поиск %2 мс, задержка %3 мс, пропущено кадров %4")
+                        .arg(static_cast<qulonglong>(result->index))
+                        .arg(result->detectionTime, 0, 'f', 1)
+                        .arg(result->latency, 0, 'f', 1)
+                        .arg(static_cast<qulonglong>(stats.droppedFrames));
+        mTargetImage->setFrame(std::move(result->image), name, std::move(centers));
+    }
+    if(!mPipeline->isRunning()) {
+        ui->pushButtonPlayDirectory->setChecked(false);
+    }
+}
+
+void WidgetPixelSizeCalibration::schedulePreview() {
+    // Результат запущенного поиска уже не соответствует параметрам или изображению
+    mPreviewJobs->cancel();
+    // Кадры воспроизведения приходят вместе с найденными центрами
+    if(!ui->checkBoxPreview->isChecked() || mTargetImage->empty() || mPipeline) {
+        mPreviewTimer->stop();
+        if(!mPreviewOverlay.empty()) {
+            mPreviewOverlay.clear();
+            ui->labelImage->update();
+        }
+        return;
+    }
+    mPreviewTimer->start();
+}
+
+void WidgetPixelSizeCalibration::startPreview() {
+    if(mTargetImage->empty()) {
+        return;
+    }
+    auto params = collectCalibrationParams();
+    auto searchParams = makeGridSearchParams(params);
+    if(params.partialGrid) {
+        searchParams.gridSize = cv::Size{};
+    }
+    // Компоненты краев переиспользуются, пока не изменились порог и исключенные области
+    searchParams.cache = mTargetImage->getDetectionCache();
+    mPreviewJobs->start([image = mTargetImage->getImage(), searchParams](const camcalib::ProgressCallback& progress) mutable {
+        searchParams.progress = progress;
+        return camcalib::previewCirclesGrid(image, searchParams);
+    }, [this](camcalib::DetectionPreview preview){
+        mPreviewOverlay.setRects(preview.candidates);
+        mPreviewOverlay.setCircles(preview.circles);
+        ui->labelImage->update();
+    });
+}
+
 void WidgetPixelSizeCalibration::startCalibration() {
     mTargetImage->startCalibration(collectCalibrationParams());
 }
@@ -92,18 +249,94 @@ void WidgetPixelSizeCalibration::addCalibrationToModel() {
     mCameraModel->addMagnification(std::move(name), *mTargetImage->getCameraMatrix());    
 }
 
+namespace {
+
+struct DistortionJobResult {
+    std::optional<camcalib::DistortionCalibrationResult> calibration;
+    size_t usedImages{};
+};
+
+}
+
+void WidgetPixelSizeCalibration::startDistortionCalibration() {
+    static auto dir = QString{};
+    auto filenames = QFileDialog::getOpenFileNames(this, tr("Снимки шаблона"), dir, tr("Изображения (*.bmp *.jpg *.png *.tif *.pgm *.raw)"));
+    if(filenames.isEmpty()) {
+        return;
+    }
+    dir = QFileInfo(filenames.front()).dir().path();
+    std::vector<std::string> files;
+    for(const auto& filename: filenames) {
+        files.push_back(filename.toStdString());
+    }
+    ui->pushButtonDistortion->setEnabled(false);
+    mDistortionJobs->start([files = std::move(files), params = collectCalibrationParams()](const camcalib::ProgressCallback& progress) {
+        auto result = DistortionJobResult{};
+        std::vector<camcalib::DistortionView> views;
+        cv::Size imageSize;
+        for(const auto& filename: files) {
+            auto frame = camcalib::mapGrayscaleImage(filename);
+            // Все снимки серии одного размера
+            if(frame.image.empty() || (!imageSize.empty() && frame.image.size() != imageSize)) {
+                continue;
+            }
+            auto [detectedGrid, generatedGrid] = detectGridCorrespondences(frame, params, progress);
+            if(!camcalib::reportStage(progress, camcalib::CalibrationStage::Solve)) {
+                return result;
+            }
+            if(!detectedGrid.empty()) {
+                imageSize = frame.image.size();
+                views.push_back({std::move(detectedGrid), std::move(generatedGrid)});
+            }
+        }
+        result.usedImages = views.size();
+        result.calibration = camcalib::calibrateDistortion(views, imageSize, {}, progress);
+        return result;
+    }, [this](DistortionJobResult result){
+        if(!result.calibration) {
+            emit error(tr("Ошибка расчета дисторсии, найдено шаблонов: %1").arg(result.usedImages));
+            return;
+        }
+        mCameraModel->setDistortion(result.calibration->distortion);
+        ui->textEditLog->setText(tr("Снимков: %1\n%2")
+                                     .arg(result.usedImages)
+                                     .arg(QString::fromStdString(result.calibration->report)));
+    });
+}
+
+void WidgetPixelSizeCalibration::updateRegionsOverlay() {
+    if(mTargetImage->empty()) {
+        return;
+    }
+    auto params = collectCalibrationParams();
+    auto bounds = Graphics::regionsBounds(params.imageROI, params.excludedRegions);
+    // Перерисовываются старое и новое положения рамок
+    auto dstRect = ui->labelImage->rect();
+    auto srcRect = mTargetImage->getImageRect();
+    ui->labelImage->update(Graphics::mapToView(dstRect, srcRect, bounds)
+                               .united(Graphics::mapToView(dstRect, srcRect, mRegionsBounds)));
+    mRegionsBounds = bounds;
+}
+
 bool WidgetPixelSizeCalibration::eventFilter(QObject *watched, QEvent *event) {
     if(watched != ui->labelImage || event->type() != QEvent::Paint) {
         return QWidget::eventFilter(watched, event);;
     }
-    auto dstRect = static_cast<QPaintEvent*>(event)->rect();
+    CAMCALIB_TRACE_SCOPE("WidgetPixelSizeCalibration::paint");
+    // Вид строится по всей метке, рисуется только перерисовываемая часть
+    auto exposedRect = static_cast<QPaintEvent*>(event)->rect();
     QPainter painter(ui->labelImage);
-    painter.fillRect(dstRect, QColor(45, 46, 47));
+    painter.fillRect(exposedRect, QColor(45, 46, 47));
     if(!mTargetImage->empty()) {
-        Graphics graphics{painter, dstRect, mTargetImage->getImageRect()};
+        Graphics graphics{painter, ui->labelImage->rect(), mTargetImage->getImageRect(), exposedRect};
         mTargetImage->draw(graphics);
-        if(auto roi = collectCalibrationParams().imageROI) {
-            graphics.drawImageROI(*roi);
+        mPreviewOverlay.draw(graphics);
+        auto params = collectCalibrationParams();
+        if(params.imageROI) {
+            graphics.drawImageROI(*params.imageROI);
+        }
+        for(const auto& region: params.excludedRegions) {
+            graphics.drawExcludedRegion(region);
         }
     }
     return false;
@@ -1,15 +1,24 @@
 #pragma once
 
+#include "OverlayLayer.h"
+#include <QRectF>
 #include <QWidget>
+#include <memory>
 
 namespace Ui {
 class WidgetPixelSizeCalibration;
 }
 
+class AsyncJobs;
 class CameraModel;
 class TargetImage;
+class QTimer;
 struct CalibrationParams;
 
+namespace camcalib {
+class FramePipeline;
+}
+
 class WidgetPixelSizeCalibration : public QWidget {
     Q_OBJECT
 signals:
@@ -25,10 +34,26 @@ private:
     void loadImageFromFile();
     void startCalibration();
     void addCalibrationToModel();
+    void startDistortionCalibration();
+    void startPlayback();
+    void stopPlayback();
+    void pollPipeline();
+    void updateRegionsOverlay();
+    void schedulePreview();
+    void startPreview();
 private:    
     Ui::WidgetPixelSizeCalibration *ui;
     CameraModel* mCameraModel{};
     TargetImage* mTargetImage{};
+    AsyncJobs* mDistortionJobs{};
+    std::unique_ptr<camcalib::FramePipeline> mPipeline;
+    QTimer* mPipelineTimer{};
+    // Предпросмотр поиска: запускается после паузы в изменении параметров
+    AsyncJobs* mPreviewJobs{};
+    QTimer* mPreviewTimer{};
+    OverlayLayer mPreviewOverlay;
+    // Рамки ROI и исключенных областей при последнем изменении, координаты изображения
+    QRectF mRegionsBounds;
 
     // QObject interface
 public:
@@ -0,0 +1,80 @@
+#include "WidgetTraceSummary.h"
+#include "ui_WidgetTraceSummary.h"
+#include "Trace.h"
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QTimer>
+
+constexpr auto SummaryUpdateInterval = 1000;
+
+WidgetTraceSummary::WidgetTraceSummary(QWidget *parent)
+    : QWidget(parent),
+    ui(new Ui::WidgetTraceSummary) {
+    ui->setupUi(this);
+    setupWidgets();
+}
+
+WidgetTraceSummary::~WidgetTraceSummary() {
+    delete ui;
+}
+
+void WidgetTraceSummary::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    updateSummary();
+    mTimer->start(SummaryUpdateInterval);
+}
+
+void WidgetTraceSummary::hideEvent(QHideEvent *event) {
+    QWidget::hideEvent(event);
+    mTimer->stop();
+}
+
+void WidgetTraceSummary::setupWidgets() {
+    mTimer = new QTimer(this);
+    connect(mTimer, &QTimer::timeout,
+            this, &WidgetTraceSummary::updateSummary);
+    connect(ui->pushButtonSave, &QPushButton::clicked,
+            this, &WidgetTraceSummary::saveTrace);
+    connect(ui->pushButtonClear, &QPushButton::clicked, this, [this]{
+        camcalib::trace::clear();
+        updateSummary();
+    });
+    if(!camcalib::trace::isCompiledIn()) {
+        ui->labelStatus->setText(tr("Трассировка отключена при сборке (CAMCALIB_ENABLE_TRACING)"));
+        ui->pushButtonSave->setEnabled(false);
+        ui->pushButtonClear->setEnabled(false);
+    }
+}
+
+void WidgetTraceSummary::updateSummary() {
+    if(!camcalib::trace::isCompiledIn()) {
+        return;
+    }
+    ui->treeWidgetSummary->clear();
+    for(const auto& entry: camcalib::trace::summary()) {
+        auto item = new QTreeWidgetItem(ui->treeWidgetSummary);
+        item->setText(0, QString::fromStdString(entry.name));
+        item->setText(1, QString::number(static_cast<qulonglong>(entry.count)));
+        // Для счетчиков - сумма, среднее и максимум значений
+        auto mean = entry.count > 0 ? entry.total / entry.count : 0.0;
+        item->setText(2, QString::number(entry.total, 'f', entry.isCounter ? 0 : 2));
+        item->setText(3, QString::number(mean, 'f', entry.isCounter ? 1 : 3));
+        item->setText(4, QString::number(entry.max, 'f', entry.isCounter ? 0 : 3));
+    }
+    auto dropped = camcalib::trace::droppedEvents();
+    ui->labelStatus->setText(dropped > 0
+                             ? tr("Буфер трассы заполнен, пропущено событий: %1").arg(static_cast<qulonglong>(dropped))
+                             : QString{});
+}
+
+void WidgetTraceSummary::saveTrace() {
+    static auto dir = QString{};
+    auto filename = QFileDialog::getSaveFileName(this, tr("Сохранить трассу"), dir, tr("Chrome trace (*.json)"));
+    if(filename.isEmpty()) {
+        return;
+    }
+    dir = QFileInfo(filename).dir().path();
+    if(!camcalib::trace::writeChromeTrace(filename.toUtf8().toStdString())) {
+        QMessageBox::critical(this, tr("Ошибка"), tr("Не удалось сохранить трассу %1").arg(filename));
+    }
+}
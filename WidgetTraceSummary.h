@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QWidget>
+
+namespace Ui {
+class WidgetTraceSummary;
+}
+
+class QTimer;
+
+// Сводка трассы по этапам, обновляется, пока вкладка видна
+class WidgetTraceSummary : public QWidget {
+    Q_OBJECT
+public:
+    explicit WidgetTraceSummary(QWidget *parent = nullptr);
+    ~WidgetTraceSummary();
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+private:
+    void setupWidgets();
+    void updateSummary();
+    void saveTrace();
+    Ui::WidgetTraceSummary *ui;
+    QTimer* mTimer{};
+};
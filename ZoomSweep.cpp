@@ -0,0 +1,83 @@
+#include "ZoomSweep.h"
+#include "Trace.h"
+
+namespace camcalib {
+
+// Допустимые отклонения метки, найденной в окне, от предсказания
+constexpr auto MaxShiftInRadii = 0.5;
+constexpr auto MinRadiusRatio = 0.8f;
+constexpr auto MaxRadiusRatio = 1.25f;
+
+ZoomSweepTracker::ZoomSweepTracker(const ZoomSweepParams &params)
+    : mParams{params} {
+    mParams.search.gridSize = cv::Size{1, 1};
+}
+
+std::optional<cv::Vec3f> ZoomSweepTracker::addFrame(const cv::Mat &image) {
+    CAMCALIB_TRACE_SCOPE("ZoomSweepTracker::addFrame");
+    ++mFrames;
+    // Окно и полный поиск 16-битного кадра используют один диапазон яркости
+    auto search = withIntensityRange(image, mParams.search);
+    auto circle = mLast ? refine(image, search) : std::nullopt;
+    if(circle) {
+        mVelocity = *circle - *mLast;
+    } else {
+        circle = detect(image, search);
+        mVelocity = {};
+    }
+    mLast = circle;
+    if(!circle) {
+        ++mLostFrames;
+        return std::nullopt;
+    }
+    auto radiusChange = mCircles.empty()
+        ? 1.0
+        : std::abs((*circle)[2] / mCircles.back()[2] - 1.0f);
+    if(radiusChange >= mParams.minRadiusChange) {
+        mCircles.push_back(*circle);
+        if(mCircles.size() >= 2) {
+            mSolution = findOpticalCenter(mCircles);
+        }
+    }
+    return circle;
+}
+
+void ZoomSweepTracker::reset() {
+    mLast.reset();
+    mVelocity = {};
+    mCircles.clear();
+    mSolution.reset();
+    mFrames = 0;
+    mLostFrames = 0;
+}
+
+std::optional<cv::Vec3f> ZoomSweepTracker::refine(const cv::Mat &image, const GridSearchParams& search) const {
+    const auto predicted = *mLast + mVelocity;
+    if(predicted[2] <= 0.0f) {
+        return std::nullopt;
+    }
+    auto half = static_cast<float>(predicted[2] * mParams.windowScale);
+    auto tl = cv::Point(cvFloor(predicted[0] - half), cvFloor(predicted[1] - half));
+    auto br = cv::Point(cvCeil(predicted[0] + half) + 1, cvCeil(predicted[1] + half) + 1);
+    auto fit = findCircleInWindow(image, cv::Rect(tl, br), search);
+    // Неудачная аппроксимация дает окружность нулевого радиуса
+    if(!fit || (*fit)[2] <= 0.0f) {
+        return std::nullopt;
+    }
+    auto shift = std::hypot((*fit)[0] - predicted[0], (*fit)[1] - predicted[1]);
+    auto ratio = (*fit)[2] / predicted[2];
+    if(shift > MaxShiftInRadii * predicted[2] || ratio < MinRadiusRatio || ratio > MaxRadiusRatio) {
+        return std::nullopt;
+    }
+    return fit;
+}
+
+std::optional<cv::Vec3f> ZoomSweepTracker::detect(const cv::Mat &image, const GridSearchParams& search) const {
+    auto circles = findCirclesGrid(image, search);
+    if(circles.empty() || circles.front()[2] <= 0.0f) {
+        return std::nullopt;
+    }
+    return circles.front();
+}
+
+}
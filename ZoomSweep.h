@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Calibration.h"
+#include "OpticalCenter.h"
+#include <opencv2/core.hpp>
+#include <optional>
+#include <vector>
+
+namespace camcalib {
+
+struct ZoomSweepParams {
+    // Полный поиск одной метки при потере слежения, gridSize заменяется на 1 x 1
+    GridSearchParams search;
+    // Полуширина окна уточнения в радиусах предсказанной метки
+    double windowScale{2.0};
+    // Окружность добавляется в решение, если ее радиус отличается от радиуса
+    // последней добавленной не менее чем на эту долю
+    double minRadiusChange{0.01};
+};
+
+// Оптический центр по последовательности кадров, снятой при плавном изменении увеличения:
+// метка отслеживается в окне вокруг предсказанного положения и радиуса,
+// решение findOpticalCenter обновляется с каждой добавленной окружностью
+class ZoomSweepTracker {
+public:
+    explicit ZoomSweepTracker(const ZoomSweepParams& params);
+    // Окружность метки на кадре, nullopt - метка не найдена
+    std::optional<cv::Vec3f> addFrame(const cv::Mat& image);
+    void reset();
+    // Окружности, вошедшие в решение, первая - базовое увеличение
+    const auto& getCircles() const {
+        return mCircles;
+    }
+    const auto& getSolution() const {
+        return mSolution;
+    }
+    auto getFrameCount() const {
+        return mFrames;
+    }
+    auto getLostFrames() const {
+        return mLostFrames;
+    }
+private:
+    std::optional<cv::Vec3f> refine(const cv::Mat& image, const GridSearchParams& search) const;
+    std::optional<cv::Vec3f> detect(const cv::Mat& image, const GridSearchParams& search) const;
+    ZoomSweepParams mParams;
+    std::optional<cv::Vec3f> mLast;
+    // Изменение центра и радиуса за последний кадр
+    cv::Vec3f mVelocity{};
+    std::vector<cv::Vec3f> mCircles;
+    std::optional<OpticalCenterSolution> mSolution;
+    size_t mFrames{};
+    size_t mLostFrames{};
+};
+
+}
@@ -0,0 +1,221 @@
+#include "BatchCalibration.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <directory|mask> [options]\n"
+              << "  --grid-width <n>        points per row\n"
+              << "  --grid-height <n>       points per column\n"
+              << "  --grid-step <mm>        distance between points\n"
+              << "  --edge-strength <value> Canny threshold (default 100)\n"
+              << "  --roi <x,y,w,h>         image region to search\n"
+              << "  --exclude <x,y,w,h>     region to skip, may be repeated\n"
+              << "  --pyramid-levels <n>    coarse-to-fine detection, 0 - full resolution\n"
+              << "  --tile <pixels>         detect in overlapping tiles, for images larger than memory\n"
+              << "  --tile-overlap <pixels> tile overlap, at least dot diameter + 4 (default 256),\n"
+              << "                          tile must be larger than 3 * overlap - 4\n"
+              << "  --fit <ellipse|gradient|geometric> dot center estimator (default ellipse)\n"
+              << "  --partial               grid may be partially visible or rotated,\n"
+              << "                          grid size is not required\n"
+              << "  --distortion            estimate lens distortion jointly over all images\n"
+              << "  --name <name>           magnification name (default: directory name)\n"
+              << "  --output <file.json>    camera model file (default: camera.json)\n"
+              << "  --trace <file.json>     write Chrome trace of the run\n"
+              << "                          (requires CAMCALIB_ENABLE_TRACING build)\n";
+}
+
+static std::optional<cv::Rect> parseRect(const std::string& text) {
+    auto rect = cv::Rect{};
+    char c1{}, c2{}, c3{};
+    std::istringstream ss(text);
+    if(ss >> rect.x >> c1 >> rect.y >> c2 >> rect.width >> c3 >> rect.height
+        && c1 == ',' && c2 == ',' && c3 == ',' && !rect.empty()) {
+        return rect;
+    }
+    return std::nullopt;
+}
+
+// Число целиком, без лишних символов и переполнения
+template<typename T>
+static std::optional<T> parseNumber(const std::string& text) {
+    auto value = T{};
+    std::istringstream ss(text);
+    if(ss >> value && (ss >> std::ws).eof()) {
+        return value;
+    }
+    return std::nullopt;
+}
+
+// Значение не меньше minValue (NaN отклоняется), иначе сообщение об ошибке
+template<typename T>
+static std::optional<T> parseOption(const std::string& arg, const std::string& text, T minValue) {
+    auto value = parseNumber<T>(text);
+    if(!value || !(*value >= minValue)) {
+        std::cerr << "Invalid value for " << arg << ": " << text << std::endl;
+        return std::nullopt;
+    }
+    return value;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    auto pattern = std::string{argv[1]};
+    auto params = CalibrationParams{100.0, 0.0, cv::Size{}, std::nullopt};
+    auto output = std::string{"camera.json"};
+    auto traceFile = std::string{};
+    auto estimateDistortion = false;
+    auto name = std::filesystem::path(pattern).parent_path().filename().string();
+    if(std::filesystem::is_directory(pattern)) {
+        name = std::filesystem::path(pattern).filename().string();
+    }
+    for(int i = 2; i < argc; i++) {
+        auto arg = std::string{argv[i]};
+        if(arg == "--partial") {
+            params.partialGrid = true;
+            continue;
+        }
+        if(arg == "--distortion") {
+            estimateDistortion = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        auto value = std::string{argv[++i]};
+        if(arg == "--grid-width") {
+            auto width = parseOption(arg, value, 1);
+            if(!width) {
+                return 1;
+            }
+            params.gridSize.width = *width;
+        } else if(arg == "--grid-height") {
+            auto height = parseOption(arg, value, 1);
+            if(!height) {
+                return 1;
+            }
+            params.gridSize.height = *height;
+        } else if(arg == "--grid-step") {
+            auto step = parseOption(arg, value, std::numeric_limits<double>::min());
+            if(!step) {
+                return 1;
+            }
+            params.gridStep = *step;
+        } else if(arg == "--edge-strength") {
+            auto strength = parseOption(arg, value, 0.0);
+            if(!strength) {
+                return 1;
+            }
+            params.edgeStrength = *strength;
+        } else if(arg == "--roi") {
+            params.imageROI = parseRect(value);
+            if(!params.imageROI) {
+                std::cerr << "Invalid ROI: " << value << std::endl;
+                return 1;
+            }
+        } else if(arg == "--exclude") {
+            auto region = parseRect(value);
+            if(!region) {
+                std::cerr << "Invalid region: " << value << std::endl;
+                return 1;
+            }
+            params.excludedRegions.push_back(*region);
+        } else if(arg == "--pyramid-levels") {
+            auto levels = parseOption(arg, value, 0);
+            if(!levels) {
+                return 1;
+            }
+            params.pyramidLevels = *levels;
+        } else if(arg == "--tile") {
+            auto tileSize = parseOption(arg, value, 1);
+            if(!tileSize) {
+                return 1;
+            }
+            params.tileSize = *tileSize;
+        } else if(arg == "--tile-overlap") {
+            auto overlap = parseOption(arg, value, 5);
+            if(!overlap) {
+                return 1;
+            }
+            params.tileOverlap = *overlap;
+        } else if(arg == "--fit") {
+            if(value == "ellipse") {
+                params.fitMethod = camcalib::CircleFitMethod::Ellipse;
+            } else if(value == "gradient") {
+                params.fitMethod = camcalib::CircleFitMethod::GradientWeighted;
+            } else if(value == "geometric") {
+                params.fitMethod = camcalib::CircleFitMethod::Geometric;
+            } else {
+                std::cerr << "Unknown fit method: " << value << std::endl;
+                return 1;
+            }
+        } else if(arg == "--name") {
+            name = value;
+        } else if(arg == "--output") {
+            output = value;
+        } else if(arg == "--trace") {
+            traceFile = value;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if((params.gridSize.empty() && !params.partialGrid) || params.gridStep <= 0.0
+        || params.edgeStrength < 0.0 || params.pyramidLevels < 0 || params.tileSize < 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if(params.tileSize > 0 && params.tileSize < minTileSize(params.tileOverlap)) {
+        std::cerr << "Tile size " << params.tileSize << " must be at least " << minTileSize(params.tileOverlap)
+                  << ": two overlaps of " << params.tileOverlap << " px and a dot of up to "
+                  << maxTiledDotDiameter(params.tileOverlap) << " px" << std::endl;
+        return 1;
+    }
+    auto files = camcalib::collectImageFiles(pattern);
+    if(files.empty()) {
+        std::cerr << "No images found: " << pattern << std::endl;
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto results = camcalib::calibrateImages(files, params);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for(const auto& result: results) {
+        std::printf("%s: points %zu, load %.1f ms, detection %.1f ms, calibration %.1f ms%s\n",
+                    result.filename.c_str(),
+                    result.detectedPoints,
+                    result.loadTime,
+                    result.detectionTime,
+                    result.calibrationTime,
+                    result.cameraMatrix ? "" : " FAILED");
+    }
+    std::printf("%zu images in %.2f s\n", results.size(), elapsed);
+    auto distortion = std::optional<camcalib::LensDistortion>{};
+    if(estimateDistortion) {
+        if(auto calibration = camcalib::calibrateDistortion(results)) {
+            std::printf("%s", calibration->report.c_str());
+            distortion = calibration->distortion;
+        } else {
+            std::cerr << "Distortion calibration failed" << std::endl;
+        }
+    }
+    if(!traceFile.empty()) {
+        if(!camcalib::trace::isCompiledIn()) {
+            std::cerr << "Tracing is disabled in this build, trace is empty" << std::endl;
+        }
+        camcalib::trace::writeChromeTrace(traceFile);
+    }
+    if(!camcalib::saveBatchReport(output, name, results, distortion)) {
+        std::cerr << "Calibration failed for all images" << std::endl;
+        return 2;
+    }
+    return 0;
+}